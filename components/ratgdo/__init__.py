@@ -28,6 +28,8 @@ DEFAULT_INPUT_OBST = "D7"  # D7 black obstruction sensor terminal
 
 CONF_DISCRETE_OPEN_PIN = "discrete_open_pin"
 CONF_DISCRETE_CLOSE_PIN = "discrete_close_pin"
+CONF_DISCRETE_LIGHT_PIN = "discrete_light_pin"
+CONF_LIGHT_AUTO_OFF = "light_auto_off"
 
 CONF_RATGDO_ID = "ratgdo_id"
 
@@ -38,7 +40,17 @@ CONF_PROTOCOL = "protocol"
 PROTOCOL_SECPLUSV1 = "secplusv1"
 PROTOCOL_SECPLUSV2 = "secplusv2"
 PROTOCOL_DRYCONTACT = "drycontact"
-SUPPORTED_PROTOCOLS = [PROTOCOL_SECPLUSV1, PROTOCOL_SECPLUSV2, PROTOCOL_DRYCONTACT]
+PROTOCOL_AUTO = "auto"
+SUPPORTED_PROTOCOLS = [PROTOCOL_SECPLUSV1, PROTOCOL_SECPLUSV2, PROTOCOL_DRYCONTACT, PROTOCOL_AUTO]
+
+CONF_WARM_BOOT = "warm_boot"
+CONF_COALESCE_WINDOW = "coalesce_window"
+CONF_DOOR_COMMAND_BURST = "door_command_burst"
+CONF_DOOR_COMMAND_REFILL = "door_command_refill"
+CONF_LISTEN_ONLY = "listen_only"
+CONF_WALL_CONTROL_EMULATION = "wall_control_emulation"
+CONF_HOT_PATH_IRAM = "hot_path_iram"
+CONF_PROFILE_HOT_PATH = "profile_hot_path"
 
 CONF_DRY_CONTACT_OPEN_SENSOR = "dry_contact_open_sensor"
 CONF_DRY_CONTACT_CLOSE_SENSOR = "dry_contact_close_sensor"
@@ -47,8 +59,16 @@ CONF_DRY_CONTACT_SENSOR_GROUP = "dry_contact_sensor_group"
 def validate_protocol(config):
     if config.get(CONF_PROTOCOL, None) == PROTOCOL_DRYCONTACT and (CONF_DRY_CONTACT_CLOSE_SENSOR not in config or CONF_DRY_CONTACT_OPEN_SENSOR not in config):
         raise cv.Invalid("dry_contact_close_sensor and dry_contact_open_sensor are required when using protocol drycontact")
-    if config.get(CONF_PROTOCOL, None) != PROTOCOL_DRYCONTACT and (CONF_DRY_CONTACT_CLOSE_SENSOR in config or CONF_DRY_CONTACT_OPEN_SENSOR in config):
-        raise cv.Invalid("dry_contact_close_sensor and dry_contact_open_sensor are only valid when using protocol drycontact")
+    if config.get(CONF_PROTOCOL, None) not in (PROTOCOL_DRYCONTACT, PROTOCOL_AUTO) and (CONF_DRY_CONTACT_CLOSE_SENSOR in config or CONF_DRY_CONTACT_OPEN_SENSOR in config):
+        raise cv.Invalid("dry_contact_close_sensor and dry_contact_open_sensor are only valid when using protocol drycontact or auto")
+    if CONF_DISCRETE_LIGHT_PIN in config and config.get(CONF_PROTOCOL, None) not in (PROTOCOL_DRYCONTACT, PROTOCOL_AUTO):
+        raise cv.Invalid("discrete_light_pin is only valid when using protocol drycontact or auto")
+    if config.get(CONF_LISTEN_ONLY, False) and config.get(CONF_PROTOCOL, None) != PROTOCOL_SECPLUSV2:
+        raise cv.Invalid("listen_only is only valid when using protocol secplusv2")
+    if config.get(CONF_WALL_CONTROL_EMULATION, False) and config.get(CONF_PROTOCOL, None) != PROTOCOL_SECPLUSV2:
+        raise cv.Invalid("wall_control_emulation is only valid when using protocol secplusv2")
+    if config.get(CONF_WALL_CONTROL_EMULATION, False) and config.get(CONF_LISTEN_ONLY, False):
+        raise cv.Invalid("wall_control_emulation can't be used with listen_only")
 #    if config.get(CONF_PROTOCOL, None) == PROTOCOL_DRYCONTACT and CONF_DRY_CONTACT_OPEN_SENSOR not in config:
 #        raise cv.Invalid("dry_contact_open_sensor is required when using protocol drycontact")
     return config    
@@ -68,6 +88,8 @@ CONFIG_SCHEMA = cv.All(
         ),
         cv.Optional(CONF_DISCRETE_OPEN_PIN): pins.gpio_output_pin_schema,
         cv.Optional(CONF_DISCRETE_CLOSE_PIN): pins.gpio_output_pin_schema,
+        cv.Optional(CONF_DISCRETE_LIGHT_PIN): pins.gpio_output_pin_schema,
+        cv.Optional(CONF_LIGHT_AUTO_OFF): cv.positive_time_period_milliseconds,
         cv.Optional(CONF_ON_SYNC_FAILED): automation.validate_automation(
             {
                 cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(SyncFailed),
@@ -76,6 +98,18 @@ CONFIG_SCHEMA = cv.All(
         cv.Optional(CONF_PROTOCOL, default=PROTOCOL_SECPLUSV2): cv.All(vol.In(
             SUPPORTED_PROTOCOLS
         )),
+        cv.Optional(CONF_WARM_BOOT, default=False): cv.boolean,
+        cv.Optional(
+            CONF_COALESCE_WINDOW, default="500ms"
+        ): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_DOOR_COMMAND_BURST, default=0): cv.int_range(min=0, max=255),
+        cv.Optional(
+            CONF_DOOR_COMMAND_REFILL, default="2min"
+        ): cv.All(cv.positive_time_period_milliseconds, cv.Range(min=cv.TimePeriod(seconds=1))),
+        cv.Optional(CONF_LISTEN_ONLY, default=False): cv.boolean,
+        cv.Optional(CONF_WALL_CONTROL_EMULATION, default=False): cv.boolean,
+        cv.Optional(CONF_HOT_PATH_IRAM, default=False): cv.boolean,
+        cv.Optional(CONF_PROFILE_HOT_PATH, default=False): cv.boolean,
         # cv.Inclusive(CONF_DRY_CONTACT_OPEN_SENSOR,CONF_DRY_CONTACT_SENSOR_GROUP): cv.use_id(binary_sensor.BinarySensor),
         # cv.Inclusive(CONF_DRY_CONTACT_CLOSE_SENSOR,CONF_DRY_CONTACT_SENSOR_GROUP): cv.use_id(binary_sensor.BinarySensor),
         cv.Optional(CONF_DRY_CONTACT_OPEN_SENSOR): cv.use_id(binary_sensor.BinarySensor),
@@ -107,6 +141,10 @@ async def to_code(config):
     if CONF_INPUT_OBST in config and config[CONF_INPUT_OBST]:
         pin = await cg.gpio_pin_expression(config[CONF_INPUT_OBST])
         cg.add(var.set_input_obst_pin(pin))
+    cg.add(var.set_warm_boot(config[CONF_WARM_BOOT]))
+    cg.add(var.set_coalesce_window(config[CONF_COALESCE_WINDOW]))
+    cg.add(var.set_door_command_burst(config[CONF_DOOR_COMMAND_BURST]))
+    cg.add(var.set_door_command_refill(config[CONF_DOOR_COMMAND_REFILL]))
 
     if CONF_DRY_CONTACT_OPEN_SENSOR in config and config[CONF_DRY_CONTACT_OPEN_SENSOR]:
         dry_contact_open_sensor = await cg.get_variable(config[CONF_DRY_CONTACT_OPEN_SENSOR])
@@ -135,13 +173,33 @@ async def to_code(config):
         cg.add_define("PROTOCOL_SECPLUSV1")
     elif config[CONF_PROTOCOL] == PROTOCOL_SECPLUSV2:
         cg.add_define("PROTOCOL_SECPLUSV2")
+        if config[CONF_LISTEN_ONLY]:
+            cg.add_define("SECPLUSV2_LISTEN_ONLY")
+        if config[CONF_WALL_CONTROL_EMULATION]:
+            cg.add_define("SECPLUSV2_WALL_CONTROL_EMULATION")
     elif config[CONF_PROTOCOL] == PROTOCOL_DRYCONTACT:
         cg.add_define("PROTOCOL_DRYCONTACT")
+    elif config[CONF_PROTOCOL] == PROTOCOL_AUTO:
+        # every engine is built in, the one in use is detected at boot
+        cg.add_define("PROTOCOL_AUTO")
+        cg.add_define("PROTOCOL_SECPLUSV1")
+        cg.add_define("PROTOCOL_SECPLUSV2")
+        cg.add_define("PROTOCOL_DRYCONTACT")
     cg.add(var.init_protocol())
 
+    if config[CONF_HOT_PATH_IRAM]:
+        cg.add_define("RATGDO_HOT_PATH_IRAM")
+    if config[CONF_PROFILE_HOT_PATH]:
+        cg.add_define("RATGDO_PROFILE_HOT_PATH")
+
     if CONF_DISCRETE_OPEN_PIN in config and config[CONF_DISCRETE_OPEN_PIN]:
         pin = await cg.gpio_pin_expression(config[CONF_DISCRETE_OPEN_PIN])
         cg.add(var.set_discrete_open_pin(pin))
     if CONF_DISCRETE_CLOSE_PIN in config and config[CONF_DISCRETE_CLOSE_PIN]:
         pin = await cg.gpio_pin_expression(config[CONF_DISCRETE_CLOSE_PIN])
-        cg.add(var.set_discrete_close_pin(pin))
\ No newline at end of file
+        cg.add(var.set_discrete_close_pin(pin))
+    if CONF_DISCRETE_LIGHT_PIN in config and config[CONF_DISCRETE_LIGHT_PIN]:
+        pin = await cg.gpio_pin_expression(config[CONF_DISCRETE_LIGHT_PIN])
+        cg.add(var.set_discrete_light_pin(pin))
+    if CONF_LIGHT_AUTO_OFF in config:
+        cg.add(var.set_light_auto_off(config[CONF_LIGHT_AUTO_OFF]))
\ No newline at end of file
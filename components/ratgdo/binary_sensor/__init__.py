@@ -18,6 +18,9 @@ TYPES = {
     "obstruction": SensorType.RATGDO_SENSOR_OBSTRUCTION,
     "motor": SensorType.RATGDO_SENSOR_MOTOR,
     "button": SensorType.RATGDO_SENSOR_BUTTON,
+    "connectivity": SensorType.RATGDO_SENSOR_CONNECTIVITY,
+    "door_fault": SensorType.RATGDO_SENSOR_DOOR_FAULT,
+    "door_throttled": SensorType.RATGDO_SENSOR_DOOR_THROTTLED,
 }
 
 
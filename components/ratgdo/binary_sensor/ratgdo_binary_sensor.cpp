@@ -9,26 +9,12 @@ namespace ratgdo {
 
     void RATGDOBinarySensor::setup()
     {
-        if (this->binary_sensor_type_ == SensorType::RATGDO_SENSOR_MOTION) {
-            this->publish_initial_state(false);
-            this->parent_->subscribe_motion_state([=](MotionState state) {
-                this->publish_state(state == MotionState::DETECTED);
-            });
-        } else if (this->binary_sensor_type_ == SensorType::RATGDO_SENSOR_OBSTRUCTION) {
-            this->publish_initial_state(false);
-            this->parent_->subscribe_obstruction_state([=](ObstructionState state) {
-                this->publish_state(state == ObstructionState::OBSTRUCTED);
-            });
-        } else if (this->binary_sensor_type_ == SensorType::RATGDO_SENSOR_MOTOR) {
-            this->parent_->subscribe_motor_state([=](MotorState state) {
-                this->publish_state(state == MotorState::ON);
-            });
-        } else if (this->binary_sensor_type_ == SensorType::RATGDO_SENSOR_BUTTON) {
+        if (this->binary_sensor_type_ != SensorType::RATGDO_SENSOR_MOTOR) {
             this->publish_initial_state(false);
-            this->parent_->subscribe_button_state([=](ButtonState state) {
-                this->publish_state(state == ButtonState::PRESSED);
-            });
         }
+        this->parent_->register_binary_sensor(this->binary_sensor_type_, this, [](void* sensor, bool state) {
+            static_cast<RATGDOBinarySensor*>(sensor)->publish_state(state);
+        });
     }
 
     void RATGDOBinarySensor::dump_config()
@@ -42,6 +28,12 @@ namespace ratgdo {
             ESP_LOGCONFIG(TAG, "  Type: Motor");
         } else if (this->binary_sensor_type_ == SensorType::RATGDO_SENSOR_BUTTON) {
             ESP_LOGCONFIG(TAG, "  Type: Button");
+        } else if (this->binary_sensor_type_ == SensorType::RATGDO_SENSOR_CONNECTIVITY) {
+            ESP_LOGCONFIG(TAG, "  Type: Connectivity");
+        } else if (this->binary_sensor_type_ == SensorType::RATGDO_SENSOR_DOOR_FAULT) {
+            ESP_LOGCONFIG(TAG, "  Type: Door Fault");
+        } else if (this->binary_sensor_type_ == SensorType::RATGDO_SENSOR_DOOR_THROTTLED) {
+            ESP_LOGCONFIG(TAG, "  Type: Door Throttled");
         }
     }
 
@@ -8,13 +8,6 @@
 namespace esphome {
 namespace ratgdo {
 
-    enum SensorType {
-        RATGDO_SENSOR_MOTION,
-        RATGDO_SENSOR_OBSTRUCTION,
-        RATGDO_SENSOR_MOTOR,
-        RATGDO_SENSOR_BUTTON
-    };
-
     class RATGDOBinarySensor : public binary_sensor::BinarySensor, public RATGDOClient, public Component {
     public:
         void setup() override;
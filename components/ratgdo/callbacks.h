@@ -3,6 +3,8 @@
 #include <utility>
 #include <vector>
 
+#include "counting_allocator.h"
+
 namespace esphome {
 namespace ratgdo {
 
@@ -22,8 +24,10 @@ namespace ratgdo {
             this->callbacks_.clear();
         }
 
+        void clear() { this->callbacks_.clear(); }
+
     protected:
-        std::vector<std::function<void(Ts...)>> callbacks_;
+        std::vector<std::function<void(Ts...)>, CountingAllocator<std::function<void(Ts...)>>> callbacks_;
     };
 
 } // namespace ratgdo
@@ -1,4 +1,11 @@
 #pragma once
 
 #define ESP_LOG1 ESP_LOGV
-#define ESP_LOG2 ESP_LOGV
\ No newline at end of file
+#define ESP_LOG2 ESP_LOGV
+
+// receive path functions called every loop, moved to IRAM with hot_path_iram
+#ifdef RATGDO_HOT_PATH_IRAM
+#define RATGDO_HOT IRAM_ATTR
+#else
+#define RATGDO_HOT
+#endif
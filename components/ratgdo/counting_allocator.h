@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace esphome {
+namespace ratgdo {
+
+    // Bytes held by ratgdo's own containers (observers, once callbacks, entity
+    // dispatch, the secplus1 transmit queue), to tell our share of the heap
+    // apart from the API and web server.
+    struct AllocStats {
+        size_t current { 0 };
+        size_t peak { 0 };
+        uint32_t allocations { 0 };
+
+        void add(size_t bytes)
+        {
+            this->current += bytes;
+            this->allocations++;
+            if (this->current > this->peak) {
+                this->peak = this->current;
+            }
+        }
+        void remove(size_t bytes) { this->current -= bytes; }
+    };
+
+    inline AllocStats& alloc_stats()
+    {
+        static AllocStats stats;
+        return stats;
+    }
+
+    template <typename T>
+    struct CountingAllocator {
+        typedef T value_type;
+
+        CountingAllocator() = default;
+        template <typename U>
+        CountingAllocator(const CountingAllocator<U>&) { }
+
+        T* allocate(size_t n)
+        {
+            alloc_stats().add(n * sizeof(T));
+            return std::allocator<T>().allocate(n);
+        }
+        void deallocate(T* p, size_t n)
+        {
+            alloc_stats().remove(n * sizeof(T));
+            std::allocator<T>().deallocate(p, n);
+        }
+
+        template <typename U>
+        bool operator==(const CountingAllocator<U>&) const { return true; }
+        template <typename U>
+        bool operator!=(const CountingAllocator<U>&) const { return false; }
+    };
+
+} // namespace ratgdo
+} // namespace esphome
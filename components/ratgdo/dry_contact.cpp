@@ -13,6 +13,11 @@ namespace ratgdo {
 
         static const char* const TAG = "ratgdo_dry_contact";
 
+        static const uint32_t DOOR_PULSE = 500;
+        static const uint32_t DOOR_PULSE_GAP = 1000;
+        static const uint32_t TRAVEL_MARGIN = 2000;
+        static const uint32_t TRAVEL_TIMEOUT_UNLEARNED = 60000;
+
         void DryContact::setup(RATGDOComponent* ratgdo, Scheduler* scheduler, InternalGPIOPin* rx_pin, InternalGPIOPin* tx_pin)
         {
             this->ratgdo_ = ratgdo;
@@ -25,6 +30,8 @@ namespace ratgdo {
             this->close_limit_reached_ = 0;
             this->last_close_limit_ = 0;
             this->door_state_ = DoorState::UNKNOWN;
+
+            this->traits_.set_features(HAS_DOOR_STATUS | HAS_DOOR_STOP);
         }
 
         void DryContact::loop()
@@ -39,6 +46,8 @@ namespace ratgdo {
         void DryContact::sync()
         {
             ESP_LOG1(TAG, "Ignoring sync action");
+            // the limit switches are the door state, nothing to wait for
+            this->ratgdo_->mark_boot_phase(BootPhase::SYNCED);
         }
 
         void DryContact::set_open_limit(bool state)
@@ -60,70 +69,246 @@ namespace ratgdo {
         }
         
         void DryContact::send_door_state(){
+            auto door_state = this->door_state_;
             if(this->open_limit_reached_){
-                this->door_state_ = DoorState::OPEN;
+                door_state = DoorState::OPEN;
             }else if(this->close_limit_reached_){
-                this->door_state_ = DoorState::CLOSED;
+                door_state = DoorState::CLOSED;
             }else if(!this->close_limit_reached_ && !this->open_limit_reached_){
                 if(this->last_close_limit_){
-                    this->door_state_ = DoorState::OPENING;
+                    door_state = DoorState::OPENING;
                 }
 
                 if(this->last_open_limit_){
-                    this->door_state_ = DoorState::CLOSING;
+                    door_state = DoorState::CLOSING;
                 }
             }
 
-            this->ratgdo_->received(this->door_state_);
+            this->set_door_state(door_state);
         }
 
         void DryContact::light_action(LightAction action)
         {
-            ESP_LOG1(TAG, "Ignoring light action: %s", LightAction_to_string(action));
-            return;
+            if (this->discrete_light_pin_ == nullptr || action == LightAction::UNKNOWN) {
+                ESP_LOG1(TAG, "Ignoring light action: %s", LOG_STR_ARG(LightAction_to_string(action)));
+                return;
+            }
+            auto light_state = LightState::UNKNOWN;
+            if (action == LightAction::TOGGLE) {
+                light_state = light_state_toggle(this->light_state_);
+            } else {
+                // an unknown light is assumed to be the other way
+                light_state = action == LightAction::ON ? LightState::ON : LightState::OFF;
+                if (light_state == this->light_state_) {
+                    this->ratgdo_->events().publish(this->light_state_);
+                    return;
+                }
+            }
+            // a second press now would be lost in the first but still flip the
+            // inferred state, leave it for the caller to retry
+            if (this->light_pulse_active_) {
+                ESP_LOGW(TAG, "Light pulse in progress, ignoring light action: %s", LOG_STR_ARG(LightAction_to_string(action)));
+                return;
+            }
+            ESP_LOG1(TAG, "Light action: %s", LOG_STR_ARG(LightAction_to_string(action)));
+            this->light_pulse_active_ = true;
+            this->discrete_light_pin_->digital_write(1);
+            this->scheduler_->set_timeout(this->ratgdo_, "light_pulse", DOOR_PULSE, [=] {
+                this->discrete_light_pin_->digital_write(0);
+                this->scheduler_->set_timeout(this->ratgdo_, "light_pulse", DOOR_PULSE_GAP, [=] { this->light_pulse_active_ = false; });
+            });
+            this->light_state_ = light_state;
+            this->ratgdo_->events().publish(this->light_state_);
         }
 
         void DryContact::lock_action(LockAction action)
         {
-            ESP_LOG1(TAG, "Ignoring lock action: %s", LockAction_to_string(action));
+            ESP_LOG1(TAG, "Ignoring lock action: %s", LOG_STR_ARG(LockAction_to_string(action)));
             return;
         }
 
+        // What one press of the single button does. The opener cycles
+        // open -> stop -> close -> stop -> open, so from STOPPED it goes the
+        // other way than it last moved.
+        static DoorState press_result(DoorState state, DoorState direction)
+        {
+            switch (state) {
+            case DoorState::OPEN:
+                return DoorState::CLOSING;
+            case DoorState::CLOSED:
+                return DoorState::OPENING;
+            case DoorState::OPENING:
+            case DoorState::CLOSING:
+                return DoorState::STOPPED;
+            case DoorState::STOPPED:
+                if (direction == DoorState::OPENING) {
+                    return DoorState::CLOSING;
+                }
+                if (direction == DoorState::CLOSING) {
+                    return DoorState::OPENING;
+                }
+                return DoorState::UNKNOWN;
+            default:
+                return DoorState::UNKNOWN;
+            }
+        }
+
+        static void press(DoorState& state, DoorState& direction)
+        {
+            if (state == DoorState::OPENING || state == DoorState::CLOSING) {
+                direction = state;
+            }
+            state = press_result(state, direction);
+        }
+
+        // presses needed on the single button, on top of those still queued,
+        // -1 when the state is unknown
+        int8_t DryContact::door_pulses(DoorAction action) const
+        {
+            auto state = this->door_state_;
+            auto direction = this->direction_;
+            for (uint8_t i = 0; i < this->door_presses_queued_; i++) {
+                press(state, direction);
+            }
+            if (action == DoorAction::TOGGLE) {
+                return 1;
+            }
+            if (state == DoorState::UNKNOWN) {
+                return -1;
+            }
+            if (action == DoorAction::STOP) {
+                return state == DoorState::OPENING || state == DoorState::CLOSING ? 1 : 0;
+            }
+            auto moving = action == DoorAction::OPEN ? DoorState::OPENING : DoorState::CLOSING;
+            auto done = action == DoorAction::OPEN ? DoorState::OPEN : DoorState::CLOSED;
+            for (int8_t pulses = 0; pulses < 4; pulses++) {
+                if (state == moving || state == done) {
+                    return pulses;
+                }
+                if (state == DoorState::UNKNOWN) {
+                    return -1;
+                }
+                press(state, direction);
+            }
+            return -1;
+        }
+
         void DryContact::door_action(DoorAction action)
         {
-            if (action == DoorAction::OPEN && this->door_state_ != DoorState::CLOSED) {
-                ESP_LOGW(TAG, "The door is not closed. Ignoring door action: %s", DoorAction_to_string(action));
+            if (action == DoorAction::UNKNOWN) {
                 return;
             }
-            if (action == DoorAction::CLOSE && this->door_state_ != DoorState::OPEN) {
-                ESP_LOGW(TAG, "The door is not open. Ignoring door action: %s", DoorAction_to_string(action));
+            // discrete inputs go straight to the wanted direction
+            if (action == DoorAction::OPEN && this->discrete_open_pin_ != nullptr) {
+                ESP_LOG1(TAG, "Door action: %s, discrete pin", LOG_STR_ARG(DoorAction_to_string(action)));
+                this->pulse_discrete(this->discrete_open_pin_);
+                if (this->door_state_ != DoorState::OPEN) {
+                    this->set_door_state(DoorState::OPENING);
+                }
+                return;
+            }
+            if (action == DoorAction::CLOSE && this->discrete_close_pin_ != nullptr) {
+                ESP_LOG1(TAG, "Door action: %s, discrete pin", LOG_STR_ARG(DoorAction_to_string(action)));
+                this->pulse_discrete(this->discrete_close_pin_);
+                if (this->door_state_ != DoorState::CLOSED) {
+                    this->set_door_state(DoorState::CLOSING);
+                }
                 return;
             }
 
-            ESP_LOG1(TAG, "Door action: %s", DoorAction_to_string(action));
-
-            if (action == DoorAction::OPEN){
-                this->discrete_open_pin_->digital_write(1);
-                this->scheduler_->set_timeout(this->ratgdo_, "", 500, [=] {
-                    this->discrete_open_pin_->digital_write(0);
-                });
+            auto pulses = this->door_pulses(action);
+            if (pulses < 0) {
+                ESP_LOGW(TAG, "Door state %s, can't tell how to %s. Ignoring door action",
+                    LOG_STR_ARG(DoorState_to_string(this->door_state_)), LOG_STR_ARG(DoorAction_to_string(action)));
+                return;
             }
+            if (pulses == 0) {
+                ESP_LOG1(TAG, "Door already %s, ignoring door action: %s",
+                    LOG_STR_ARG(DoorState_to_string(this->door_state_)), LOG_STR_ARG(DoorAction_to_string(action)));
+                return;
+            }
+            ESP_LOGD(TAG, "Door action: %s from %s, %d presses", LOG_STR_ARG(DoorAction_to_string(action)),
+                LOG_STR_ARG(DoorState_to_string(this->door_state_)), pulses);
+            this->pulse_door(pulses);
+        }
 
-            if (action == DoorAction::CLOSE){
-                this->discrete_close_pin_->digital_write(1);
-                this->scheduler_->set_timeout(this->ratgdo_, "", 500, [=] {
-                    this->discrete_close_pin_->digital_write(0);
-                });
+        // Presses queue up behind the one in progress and are chained through the
+        // scheduler so the loop never blocks. The opener needs a gap between them
+        // to take the next one.
+        void DryContact::pulse_door(uint8_t pulses)
+        {
+            this->door_presses_queued_ += pulses;
+            if (!this->door_pulse_active_) {
+                this->next_door_press();
             }
+        }
 
+        void DryContact::next_door_press()
+        {
+            if (this->door_presses_queued_ == 0) {
+                this->door_pulse_active_ = false;
+                return;
+            }
+            this->door_presses_queued_--;
+            this->door_pulse_active_ = true;
             this->tx_pin_->digital_write(1); // Single button control
-            this->scheduler_->set_timeout(this->ratgdo_, "", 500, [=] {
+            this->door_pressed();
+            this->scheduler_->set_timeout(this->ratgdo_, "door_pulse", DOOR_PULSE, [=] {
                 this->tx_pin_->digital_write(0);
+                this->scheduler_->set_timeout(this->ratgdo_, "door_pulse", DOOR_PULSE_GAP, [=] { this->next_door_press(); });
+            });
+        }
+
+        void DryContact::pulse_discrete(InternalGPIOPin* pin)
+        {
+            pin->digital_write(1);
+            this->scheduler_->set_timeout(this->ratgdo_, "", DOOR_PULSE, [=] {
+                pin->digital_write(0);
+            });
+        }
+
+        void DryContact::door_pressed()
+        {
+            auto door_state = press_result(this->door_state_, this->direction_);
+            if (door_state != DoorState::UNKNOWN) {
+                this->set_door_state(door_state);
+            }
+        }
+
+        void DryContact::set_door_state(DoorState door_state)
+        {
+            if (door_state == DoorState::OPENING || door_state == DoorState::CLOSING) {
+                this->direction_ = door_state;
+            }
+            this->door_state_ = door_state;
+            this->arm_travel_check();
+            this->ratgdo_->events().publish(this->door_state_);
+        }
+
+        // Only the limit switches are seen. A door that was sent moving and
+        // reaches neither within its travel time stopped somewhere between.
+        void DryContact::arm_travel_check()
+        {
+            auto door_state = this->door_state_;
+            if (door_state != DoorState::OPENING && door_state != DoorState::CLOSING) {
+                this->scheduler_->cancel_timeout(this->ratgdo_, "door_travel_check");
+                return;
+            }
+            auto duration = door_state == DoorState::OPENING ? *this->ratgdo_->opening_duration : *this->ratgdo_->closing_duration;
+            uint32_t timeout = duration > 0 ? duration * 1000 + TRAVEL_MARGIN : TRAVEL_TIMEOUT_UNLEARNED;
+            this->scheduler_->set_timeout(this->ratgdo_, "door_travel_check", timeout, [=] {
+                ESP_LOGW(TAG, "Door %s but no limit switch reached after %" PRIu32 "ms, assuming stopped",
+                    LOG_STR_ARG(DoorState_to_string(door_state)), timeout);
+                this->set_door_state(DoorState::STOPPED);
             });
         }
 
         Result DryContact::call(Args args)
         {
+            if (args.tag == Args::Tag::flush_door_commands) {
+                // the press in progress finishes, its state is already published
+                this->door_presses_queued_ = 0;
+            }
             return {};
         }
 
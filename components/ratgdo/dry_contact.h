@@ -40,12 +40,21 @@ namespace ratgdo {
                 this->discrete_open_pin_ = pin;
                 this->discrete_open_pin_->setup();
                 this->discrete_open_pin_->pin_mode(gpio::FLAG_OUTPUT);
+                this->traits_.set_features(HAS_DOOR_OPEN);
             }
 
             void set_discrete_close_pin(InternalGPIOPin* pin) {
                 this->discrete_close_pin_ = pin;
                 this->discrete_close_pin_->setup();
                 this->discrete_close_pin_->pin_mode(gpio::FLAG_OUTPUT);
+                this->traits_.set_features(HAS_DOOR_CLOSE);
+            }
+
+            void set_discrete_light_pin(InternalGPIOPin* pin) {
+                this->discrete_light_pin_ = pin;
+                this->discrete_light_pin_->setup();
+                this->discrete_light_pin_->pin_mode(gpio::FLAG_OUTPUT);
+                this->traits_.set_features(HAS_LIGHT_TOGGLE);
             }
 
             Result call(Args args);
@@ -53,12 +62,21 @@ namespace ratgdo {
             const Traits& traits() const { return this->traits_; }
 
         protected:
+            int8_t door_pulses(DoorAction action) const;
+            void pulse_door(uint8_t pulses);
+            void next_door_press();
+            void pulse_discrete(InternalGPIOPin* pin);
+            void door_pressed();
+            void set_door_state(DoorState door_state);
+            void arm_travel_check();
+
             Traits traits_;
 
             InternalGPIOPin* tx_pin_;
             InternalGPIOPin* rx_pin_;
-            InternalGPIOPin* discrete_open_pin_;
-            InternalGPIOPin* discrete_close_pin_;
+            InternalGPIOPin* discrete_open_pin_ { nullptr };
+            InternalGPIOPin* discrete_close_pin_ { nullptr };
+            InternalGPIOPin* discrete_light_pin_ { nullptr };
 
             RATGDOComponent* ratgdo_;
             Scheduler* scheduler_;
@@ -68,6 +86,13 @@ namespace ratgdo {
             bool last_open_limit_;
             bool close_limit_reached_;
             bool last_close_limit_;
+            // last way the door moved, decides what a press does from STOPPED
+            DoorState direction_ { DoorState::UNKNOWN };
+            bool door_pulse_active_ { false }; // a press or the gap after it
+            uint8_t door_presses_queued_ { 0 };
+            // the light relay only toggles, this is what it should be after the presses we made
+            LightState light_state_ { LightState::UNKNOWN };
+            bool light_pulse_active_ { false };
 
         };
 
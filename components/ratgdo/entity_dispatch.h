@@ -0,0 +1,36 @@
+#pragma once
+#include <vector>
+
+#include "counting_allocator.h"
+
+namespace esphome {
+namespace ratgdo {
+
+    // Fans a state value out to every entity registered for it. Entries are a
+    // plain pointer pair, so all entities of one kind share a single observer
+    // instead of each holding its own std::function.
+    template <typename T>
+    class EntityDispatch {
+    public:
+        typedef void (*Publish)(void* entity, T value);
+
+        void add(void* entity, Publish publish) { this->entities_.push_back({ entity, publish }); }
+        bool empty() const { return this->entities_.empty(); }
+
+        void operator()(T value) const
+        {
+            for (const auto& entry : this->entities_) {
+                entry.publish(entry.entity, value);
+            }
+        }
+
+    protected:
+        struct Entry {
+            void* entity;
+            Publish publish;
+        };
+        std::vector<Entry, CountingAllocator<Entry>> entities_;
+    };
+
+} // namespace ratgdo
+} // namespace esphome
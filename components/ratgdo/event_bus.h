@@ -0,0 +1,88 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+
+#include "ratgdo_state.h"
+
+namespace esphome {
+namespace ratgdo {
+
+    // Subscribers per event type. A subscription past this is refused.
+    const size_t EVENT_SUBSCRIBERS = 4;
+
+    // Fixed-capacity list of handlers for one event type. Subscribers are a
+    // plain pointer pair so publishing never allocates.
+    template <typename T, size_t N>
+    class EventChannel {
+    public:
+        typedef void (*Handler)(void* context, T event);
+
+        bool subscribe(void* context, Handler handler)
+        {
+            if (this->count_ == N) {
+                return false;
+            }
+            this->entries_[this->count_++] = { context, handler };
+            return true;
+        }
+
+        void publish(T event) const
+        {
+            for (size_t i = 0; i < this->count_; i++) {
+                this->entries_[i].handler(this->entries_[i].context, event);
+            }
+        }
+
+        size_t size() const { return this->count_; }
+
+    protected:
+        struct Entry {
+            void* context;
+            Handler handler;
+        };
+        std::array<Entry, N> entries_ {};
+        uint8_t count_ { 0 };
+    };
+
+    // What the protocols report to the rest of the component. The channel is
+    // picked from the event type at compile time.
+    class EventBus {
+    public:
+        template <typename T>
+        using Channel = EventChannel<T, EVENT_SUBSCRIBERS>;
+
+        template <typename T>
+        bool subscribe(void* context, typename Channel<T>::Handler handler)
+        {
+            return std::get<Channel<T>>(this->channels_).subscribe(context, handler);
+        }
+
+        template <typename T>
+        void publish(T event) const
+        {
+            std::get<Channel<T>>(this->channels_).publish(event);
+        }
+
+    protected:
+        std::tuple<
+            Channel<DoorState>,
+            Channel<LightState>,
+            Channel<LockState>,
+            Channel<ObstructionState>,
+            Channel<LightAction>,
+            Channel<MotorState>,
+            Channel<ButtonState>,
+            Channel<MotionState>,
+            Channel<LearnState>,
+            Channel<Openings>,
+            Channel<TimeToClose>,
+            Channel<PairedDeviceCount>,
+            Channel<BatteryState>,
+            Channel<LinkState>>
+            channels_;
+    };
+
+} // namespace ratgdo
+} // namespace esphome
@@ -21,6 +21,8 @@ namespace ratgdo {
         });
     }
 
+    // state reported by the opener, applied to the light without going
+    // through write_state so it is never sent back as a command
     void RATGDOLightOutput::on_light_state(esphome::ratgdo::LightState state)
     {
         if (this->light_state_) {
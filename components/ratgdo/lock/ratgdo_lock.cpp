@@ -20,22 +20,14 @@ namespace ratgdo {
         });
     }
 
+    // state reported by the opener, only published, never sent back as a command
     void RATGDOLock::on_lock_state(LockState state)
     {
-        if (state == LockState::LOCKED && this->state == lock::LockState::LOCK_STATE_LOCKED) {
-            return;
+        if (state == LockState::LOCKED && this->state != lock::LockState::LOCK_STATE_LOCKED) {
+            this->publish_state(lock::LockState::LOCK_STATE_LOCKED);
+        } else if (state == LockState::UNLOCKED && this->state != lock::LockState::LOCK_STATE_UNLOCKED) {
+            this->publish_state(lock::LockState::LOCK_STATE_UNLOCKED);
         }
-        if (state == LockState::UNLOCKED && this->state == lock::LockState::LOCK_STATE_UNLOCKED) {
-            return;
-        }
-
-        auto call = this->make_call();
-        if (state == LockState::LOCKED) {
-            call.set_state(lock::LockState::LOCK_STATE_LOCKED);
-        } else if (state == LockState::UNLOCKED) {
-            call.set_state(lock::LockState::LOCK_STATE_UNLOCKED);
-        }
-        this->control(call);
     }
 
     void RATGDOLock::control(const lock::LockCall& call)
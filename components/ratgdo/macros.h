@@ -1,4 +1,5 @@
 
+#include "esphome/core/log.h"
 
 #define PARENS ()
 
@@ -25,7 +26,7 @@
 
 #define TO_STRING_CASE0(type, name, val) \
     case type::name:                     \
-        return #name;
+        return LOG_STR(#name);
 #define TO_STRING_CASE(type, tuple) TO_STRING_CASE0 LPAREN type, TUPLE tuple)
 
 #define FROM_INT_CASE0(type, name, val) \
@@ -37,13 +38,13 @@
     enum class name : type {                            \
         FOR_EACH(ENUM_VARIANT, name, __VA_ARGS__)       \
     };                                                  \
-    inline const char*                                  \
+    inline const esphome::LogString*                   \
         name##_to_string(name _e)                       \
     {                                                   \
         switch (_e) {                                   \
             FOR_EACH(TO_STRING_CASE, name, __VA_ARGS__) \
         default:                                        \
-            return "UNKNOWN";                           \
+            return LOG_STR("UNKNOWN");                  \
         }                                               \
     }                                                   \
     inline name                                         \
@@ -8,16 +8,22 @@ namespace ratgdo {
     using protocol::SetClientID;
     using protocol::SetRollingCodeCounter;
 
-    float normalize_client_id(float client_id)
+    uint32_t normalize_client_id(uint32_t client_id)
     {
-        uint32_t int_value = static_cast<uint32_t>(client_id);
-        if ((int_value & 0xFFF) != 0x539) {
-            client_id = ceil((client_id - 0x539) / 0x1000) * 0x1000 + 0x539;
+        if ((client_id & 0xFFF) != 0x539) {
+            client_id = ((client_id + 0xFFF - 0x539) & ~0xFFF) + 0x539;
         }
         return client_id;
     }
 
+    uint32_t new_client_id()
+    {
+        // the number entity still reports state as float, keep the id within its exact range
+        return ((random_uint32() + 1) % 0x7FF) << 12 | 0x539;
+    }
+
     static const char* const TAG = "ratgdo.number";
+    static const uint32_t INTEGER_PREF_HASH_SALT = 0x5A17C0DE;
 
     void RATGDONumber::dump_config()
     {
@@ -35,24 +41,16 @@ namespace ratgdo {
 
     void RATGDONumber::setup()
     {
-        float value;
-        this->pref_ = global_preferences->make_preference<float>(this->get_object_id_hash());
-        if (!this->pref_.load(&value)) {
-            if (this->number_type_ == RATGDO_CLIENT_ID) {
-                value = ((random_uint32() + 1) % 0x7FF) << 12 | 0x539; // max size limited to be precisely convertible to float
-            } else {
-                value = 0;
-            }
+        if (this->is_integer_type()) {
+            this->setup_integer();
         } else {
-            if (this->number_type_ == RATGDO_CLIENT_ID) {
-                uint32_t int_value = static_cast<uint32_t>(value);
-                if ((int_value & 0xFFF) != 0x539) {
-                    value = ((random_uint32() + 1) % 0x7FF) << 12 | 0x539; // max size limited to be precisely convertible to float
-                    this->pref_.save(&value);
-                }
+            float value;
+            this->pref_ = global_preferences->make_preference<float>(this->get_object_id_hash());
+            if (!this->pref_.load(&value)) {
+                value = 0;
             }
+            this->control(value);
         }
-        this->control(value);
 
         if (this->number_type_ == RATGDO_ROLLING_CODE_COUNTER) {
             this->parent_->subscribe_rolling_code_counter([=](uint32_t value) {
@@ -69,6 +67,30 @@ namespace ratgdo {
         }
     }
 
+    void RATGDONumber::setup_integer()
+    {
+        uint32_t value;
+        // integer values get their own preference slot, a float and a uint32_t
+        // have the same size so they can't share one without being misread
+        this->pref_ = global_preferences->make_preference<uint32_t>(this->get_object_id_hash() ^ INTEGER_PREF_HASH_SALT);
+        if (!this->pref_.load(&value)) {
+            float legacy_value;
+            auto legacy_pref = global_preferences->make_preference<float>(this->get_object_id_hash());
+            if (legacy_pref.load(&legacy_value)) {
+                value = static_cast<uint32_t>(legacy_value);
+                ESP_LOGD(TAG, "Migrating float preference to integer: %" PRIu32, value);
+            } else if (this->number_type_ == RATGDO_CLIENT_ID) {
+                value = new_client_id();
+            } else {
+                value = 0;
+            }
+        }
+        if (this->number_type_ == RATGDO_CLIENT_ID && (value & 0xFFF) != 0x539) {
+            value = new_client_id();
+        }
+        this->control_integer(value);
+    }
+
     void RATGDONumber::set_number_type(NumberType number_type_)
     {
         this->number_type_ = number_type_;
@@ -94,17 +116,38 @@ namespace ratgdo {
         this->publish_state(value);
     }
 
+    void RATGDONumber::update_state(uint32_t value)
+    {
+        if (this->has_integer_state_ && value == this->integer_state_) {
+            return;
+        }
+        this->integer_state_ = value;
+        this->has_integer_state_ = true;
+        this->pref_.save(&value);
+        this->publish_state(value);
+    }
+
     void RATGDONumber::control(float value)
     {
-        if (this->number_type_ == RATGDO_ROLLING_CODE_COUNTER) {
-            this->parent_->call_protocol(SetRollingCodeCounter { static_cast<uint32_t>(value) });
-        } else if (this->number_type_ == RATGDO_OPENING_DURATION) {
+        if (this->is_integer_type()) {
+            this->control_integer(static_cast<uint32_t>(value));
+            return;
+        }
+        if (this->number_type_ == RATGDO_OPENING_DURATION) {
             this->parent_->set_opening_duration(value);
         } else if (this->number_type_ == RATGDO_CLOSING_DURATION) {
             this->parent_->set_closing_duration(value);
+        }
+        this->update_state(value);
+    }
+
+    void RATGDONumber::control_integer(uint32_t value)
+    {
+        if (this->number_type_ == RATGDO_ROLLING_CODE_COUNTER) {
+            this->parent_->call_protocol(SetRollingCodeCounter { value });
         } else if (this->number_type_ == RATGDO_CLIENT_ID) {
             value = normalize_client_id(value);
-            this->parent_->call_protocol(SetClientID { static_cast<uint32_t>(value) });
+            this->parent_->call_protocol(SetClientID { value });
         }
         this->update_state(value);
     }
@@ -26,11 +26,20 @@ namespace ratgdo {
         float get_setup_priority() const override { return setup_priority::HARDWARE + 1; }
 
         void update_state(float value);
+        void update_state(uint32_t value);
         void control(float value) override;
 
     protected:
+        // client id and rolling code counter are integers, persisted and set
+        // without a round trip through float
+        bool is_integer_type() const { return this->number_type_ == RATGDO_CLIENT_ID || this->number_type_ == RATGDO_ROLLING_CODE_COUNTER; }
+        void setup_integer();
+        void control_integer(uint32_t value);
+
         NumberType number_type_;
         ESPPreferenceObject pref_;
+        uint32_t integer_state_ { 0 };
+        bool has_integer_state_ { false };
     };
 
 } // namespace ratgdo
@@ -3,6 +3,8 @@
 #include <utility>
 #include <vector>
 
+#include "counting_allocator.h"
+
 namespace esphome {
 namespace ratgdo {
 
@@ -42,7 +44,7 @@ namespace ratgdo {
 
     private:
         T value_;
-        std::vector<std::function<void(T)>> observers_;
+        std::vector<std::function<void(T)>, CountingAllocator<std::function<void(T)>>> observers_;
     };
 
 } // namespace ratgdo
@@ -0,0 +1,59 @@
+#pragma once
+#include <algorithm>
+
+#include "esphome/core/hal.h"
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace ratgdo {
+
+    // Cycle counts for one hot function, logged every REPORT_CALLS calls. Only
+    // built with profile_hot_path, to weigh a function's IRAM cost against
+    // what it saves.
+    struct CycleStats {
+        static const uint32_t REPORT_CALLS = 4096;
+
+        const char* name;
+        uint32_t calls { 0 };
+        uint64_t cycles { 0 };
+        uint32_t max { 0 };
+
+        void add(uint32_t spent)
+        {
+            this->calls++;
+            this->cycles += spent;
+            this->max = std::max(this->max, spent);
+            if (this->calls == REPORT_CALLS) {
+                ESP_LOGD("ratgdo.profile", "%s: avg %" PRIu32 " cycles, max %" PRIu32 " over %" PRIu32 " calls",
+                    this->name, static_cast<uint32_t>(this->cycles / this->calls), this->max, this->calls);
+                this->calls = 0;
+                this->cycles = 0;
+                this->max = 0;
+            }
+        }
+    };
+
+    class CycleCounter {
+    public:
+        CycleCounter(CycleStats& stats)
+            : stats_(stats)
+            , start_(arch_get_cpu_cycle_count())
+        {
+        }
+        ~CycleCounter() { this->stats_.add(arch_get_cpu_cycle_count() - this->start_); }
+
+    protected:
+        CycleStats& stats_;
+        uint32_t start_;
+    };
+
+} // namespace ratgdo
+} // namespace esphome
+
+#ifdef RATGDO_PROFILE_HOT_PATH
+#define RATGDO_PROFILE(name)                        \
+    static esphome::ratgdo::CycleStats stats_ { name }; \
+    esphome::ratgdo::CycleCounter cycle_counter_(stats_)
+#else
+#define RATGDO_PROFILE(name)
+#endif
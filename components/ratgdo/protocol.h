@@ -23,12 +23,17 @@ namespace ratgdo {
 
         const uint32_t HAS_LOCK_TOGGLE = 1 << 20;
 
+        // light and lock commands usually show up in the state within this
+        const uint32_t DEFAULT_COMMAND_TIMEOUT = 3000;
+
         class Traits {
             uint32_t value;
+            uint32_t command_timeout;
 
         public:
             Traits()
                 : value(0)
+                , command_timeout(DEFAULT_COMMAND_TIMEOUT)
             {
             }
 
@@ -44,6 +49,12 @@ namespace ratgdo {
             void set_features(uint32_t feature) { this->value |= feature; }
             void clear_features(uint32_t feature) { this->value &= ~feature; }
 
+            // how long to wait for a light or lock command to be reported before
+            // sending it again, toggle-only protocols must cover their slowest
+            // confirmation or a retry flips it back
+            uint32_t get_command_timeout() const { return this->command_timeout; }
+            void set_command_timeout(uint32_t timeout) { this->command_timeout = timeout; }
+
             static uint32_t all()
             {
                 return HAS_DOOR_CLOSE | HAS_DOOR_OPEN | HAS_DOOR_STOP | HAS_DOOR_STATUS | HAS_LIGHT_TOGGLE | HAS_LOCK_TOGGLE;
@@ -74,6 +85,9 @@ namespace ratgdo {
         struct ClearPairedDevices {
             PairedDevice kind;
         };
+        // drop door commands that haven't gone out yet
+        struct FlushDoorCommands {
+        };
 
         // a poor man's sum-type, because C++
         SUM_TYPE(Args,
@@ -86,7 +100,8 @@ namespace ratgdo {
             (InactivateLearn, inactivate_learn),
             (QueryPairedDevices, query_paired_devices),
             (QueryPairedDevicesAll, query_paired_devices_all),
-            (ClearPairedDevices, clear_paired_devices), )
+            (ClearPairedDevices, clear_paired_devices),
+            (FlushDoorCommands, flush_door_commands), )
 
         struct RollingCodeCounter {
             observable<uint32_t>* value;
@@ -108,6 +123,7 @@ namespace ratgdo {
             virtual void set_close_limit(bool);
             virtual void set_discrete_open_pin(InternalGPIOPin* pin);
             virtual void set_discrete_close_pin(InternalGPIOPin* pin);
+            virtual void set_discrete_light_pin(InternalGPIOPin* pin);
 
             virtual const Traits& traits() const;
 
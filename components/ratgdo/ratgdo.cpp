@@ -14,6 +14,7 @@
 #include "ratgdo.h"
 #include "common.h"
 #include "dry_contact.h"
+#include "profile.h"
 #include "ratgdo_state.h"
 #include "secplus1.h"
 #include "secplus2.h"
@@ -22,6 +23,13 @@
 #include "esphome/core/gpio.h"
 #include "esphome/core/log.h"
 
+#ifdef USE_ESP8266
+#include <Esp.h>
+#elif defined(USE_ESP32)
+#include <esp_heap_caps.h>
+#include <esp_system.h>
+#endif
+
 namespace esphome {
 namespace ratgdo {
 
@@ -29,9 +37,34 @@ namespace ratgdo {
 
     static const char* const TAG = "ratgdo";
     static const int SYNC_DELAY = 1000;
+    static const uint32_t SNAPSHOT_MAGIC = 0x52474431;
+    static const uint32_t RESYNC_DELAY_MIN = 5000;
+    static const uint32_t RESYNC_DELAY_MAX = 300000;
+    // how long a door command may take before the reconciler tries again, light
+    // and lock use the protocol's command timeout
+    static const uint32_t DOOR_COMMAND_TIMEOUT = 10000;
+    static const uint8_t MAX_TARGET_COMMANDS = 4;
+    // a moving door is expected at the end of its travel by the learned duration
+    // plus a margin, after that status is queried a few times before it's a fault
+    static const uint32_t TRAVEL_MARGIN = 2000;
+    static const uint32_t TRAVEL_TIMEOUT_UNLEARNED = 60000;
+    static const uint32_t TRAVEL_QUERY_INTERVAL = 2000;
+    static const uint8_t TRAVEL_MAX_QUERIES = 3;
+    // how long each engine listens during protocol detection, nothing is sent
+    // until traffic shows up so this is how long a silent line is given
+    static const uint32_t DETECT_SECPLUSV2_TIMEOUT = 20000;
+    static const uint32_t DETECT_SECPLUSV1_TIMEOUT = 60000;
+    static const uint8_t PROTOCOL_CONFIRMED = 0x80;
+    static const uint32_t STATE_TIME_UPDATE_INTERVAL = 60 * 1000;
+    static const uint32_t STATE_TIME_SAVE_INTERVAL = 15 * 60 * 1000;
+    static const uint32_t STATE_TIME_HOUR = 60 * 60 * 1000;
+    static const uint32_t STATE_TIME_MAGIC = 0x52545332;
+    static const uint32_t MEMORY_REPORT_INTERVAL = 60000;
 
     void RATGDOComponent::setup()
     {
+        this->mark_boot_phase(BootPhase::SETUP);
+
         this->output_gdo_pin_->setup();
         this->output_gdo_pin_->pin_mode(gpio::FLAG_OUTPUT);
 
@@ -49,9 +82,50 @@ namespace ratgdo {
         }
 
         this->protocol_->setup(this, &App.scheduler, this->input_gdo_pin_, this->output_gdo_pin_);
+        this->mark_boot_phase(BootPhase::PROTOCOL_SETUP);
+        this->sync_failed.subscribe([=](bool failed) {
+            if (failed) {
+                this->mark_boot_phase(BootPhase::SYNC_FAILED);
+            }
+        });
+#ifdef PROTOCOL_AUTO
+        if (!this->protocol_confirmed_) {
+            this->start_protocol_detection();
+        }
+#endif
+
+        RATGDOSnapshot snapshot;
+        if (this->warm_boot_ && !this->sync_on_traffic_ && this->load_snapshot(snapshot)) {
+            // the opener state almost certainly didn't change during a restart,
+            // publish the saved state once children are set up and only verify it
+            defer([=] { this->restore_snapshot(snapshot); });
+        } else if (!this->sync_on_traffic_) {
+            // many things happening at startup, use some delay for sync
+            set_timeout(SYNC_DELAY, [=] { this->sync(); });
+        }
+        this->init_state_times();
+        if (this->door_command_burst_ > 0) {
+            this->motor_state.subscribe([=](MotorState state) { this->update_motor_running(); });
+            this->door_state.subscribe([=](DoorState state) { this->update_motor_running(); });
+        }
+        if (this->light_auto_off_ > 0) {
+            this->light_state.subscribe([=](LightState state) {
+                if (state == LightState::ON) {
+                    set_timeout("light_auto_off", this->light_auto_off_, [=] { this->light_off(); });
+                } else {
+                    cancel_timeout("light_auto_off");
+                }
+            });
+        }
+        // synchronous, so queued motion is dropped in the loop that sees the obstruction
+        this->obstruction_state.subscribe([=](ObstructionState state) {
+            if (state == ObstructionState::OBSTRUCTED) {
+                this->preempt_door_commands();
+            }
+        });
+        defer([=] { this->report_memory("setup"); });
+        set_interval("memory_report", MEMORY_REPORT_INTERVAL, [=] { this->report_memory(nullptr); });
 
-        // many things happening at startup, use some delay for sync
-        set_timeout(SYNC_DELAY, [=] { this->sync(); });
         ESP_LOGD(TAG, " _____ _____ _____ _____ ____  _____ ");
         ESP_LOGD(TAG, "| __  |  _  |_   _|   __|    \\|     |");
         ESP_LOGD(TAG, "|    -|     | | | |  |  |  |  |  |  |");
@@ -59,21 +133,106 @@ namespace ratgdo {
         ESP_LOGD(TAG, "https://paulwieland.github.io/ratgdo/");
     }
 
+    void RATGDOComponent::subscribe_events()
+    {
+        this->subscribe_event<DoorState>();
+        this->subscribe_event<LightState>();
+        this->subscribe_event<LockState>();
+        this->subscribe_event<ObstructionState>();
+        this->subscribe_event<LightAction>();
+        this->subscribe_event<MotorState>();
+        this->subscribe_event<ButtonState>();
+        this->subscribe_event<MotionState>();
+        this->subscribe_event<LearnState>();
+        this->subscribe_event<Openings>();
+        this->subscribe_event<TimeToClose>();
+        this->subscribe_event<PairedDeviceCount>();
+        this->subscribe_event<BatteryState>();
+        this->subscribe_event<LinkState>();
+    }
+
     // initializing protocol, this gets called before setup() because
     // its children components might require that
     void RATGDOComponent::init_protocol()
     {
-#ifdef PROTOCOL_SECPLUSV2
+        this->subscribe_events();
+
+#ifdef PROTOCOL_AUTO
+        // all engines are built in, use the one detected on an earlier boot
+        // or the next one to try
+        this->protocol_pref_ = global_preferences->make_preference<uint8_t>(
+            fnv1_hash("ratgdo_protocol") + this->output_gdo_pin_->get_pin());
+        uint8_t stored = 0;
+        this->protocol_pref_.load(&stored);
+        this->protocol_confirmed_ = stored & PROTOCOL_CONFIRMED;
+        this->detected_protocol_ = to_DetectedProtocol(stored & ~PROTOCOL_CONFIRMED, DetectedProtocol::UNKNOWN);
+        if (this->dry_contact_open_sensor_ != nullptr && this->dry_contact_close_sensor_ != nullptr) {
+            // the security+ engines transmit on the line a dry contact opener
+            // reads as its button, with limit switches wired nothing else is tried
+            this->detected_protocol_ = DetectedProtocol::DRYCONTACT;
+            this->protocol_confirmed_ = true;
+        } else if (this->detected_protocol_ == DetectedProtocol::UNKNOWN || this->detected_protocol_ == DetectedProtocol::DRYCONTACT) {
+            this->detected_protocol_ = DetectedProtocol::SECPLUSV2;
+            this->protocol_confirmed_ = false;
+        }
+        if (this->detected_protocol_ == DetectedProtocol::SECPLUSV1) {
+            this->protocol_ = new secplus1::Secplus1();
+        } else if (this->detected_protocol_ == DetectedProtocol::DRYCONTACT) {
+            this->protocol_ = new dry_contact::DryContact();
+        } else {
+            this->protocol_ = new secplus2::Secplus2();
+        }
+#elif defined(PROTOCOL_SECPLUSV2)
         this->protocol_ = new secplus2::Secplus2();
-#endif
-#ifdef PROTOCOL_SECPLUSV1
+#elif defined(PROTOCOL_SECPLUSV1)
         this->protocol_ = new secplus1::Secplus1();
-#endif
-#ifdef PROTOCOL_DRYCONTACT
+#elif defined(PROTOCOL_DRYCONTACT)
         this->protocol_ = new dry_contact::DryContact();
 #endif
     }
 
+    // Limit switches mean dry contact, the security+ engines are only tried
+    // without them. A candidate only listens until traffic shows up on the line,
+    // which rules out a dry contact opener, and only then syncs (transmits). It is
+    // confirmed once it decodes traffic from the opener (link state CONNECTED).
+    // When it doesn't confirm in time the next one is saved and the device
+    // reboots into it: secplus2, secplus1. After the last one detection stops
+    // until the next boot.
+    void RATGDOComponent::start_protocol_detection()
+    {
+        auto protocol = this->detected_protocol_;
+        ESP_LOGI(TAG, "Detecting protocol, listening with %s", LOG_STR_ARG(DetectedProtocol_to_string(protocol)));
+        this->sync_on_traffic_ = true;
+        uint32_t timeout = protocol == DetectedProtocol::SECPLUSV2 ? DETECT_SECPLUSV2_TIMEOUT : DETECT_SECPLUSV1_TIMEOUT;
+        set_timeout("protocol_detect", timeout, [=] {
+            auto next = DetectedProtocol::UNKNOWN;
+            if (protocol == DetectedProtocol::SECPLUSV2) {
+                next = DetectedProtocol::SECPLUSV1;
+            }
+            if (next == DetectedProtocol::UNKNOWN) {
+                ESP_LOGE(TAG, "No opener detected, detection starts over on the next boot");
+                this->save_protocol(DetectedProtocol::UNKNOWN, false);
+                this->sync_failed = true;
+                return;
+            }
+            ESP_LOGW(TAG, "Nothing heard with %s, rebooting to try %s",
+                LOG_STR_ARG(DetectedProtocol_to_string(protocol)), LOG_STR_ARG(DetectedProtocol_to_string(next)));
+            this->save_protocol(next, false);
+            App.safe_reboot();
+        });
+    }
+
+    void RATGDOComponent::save_protocol(DetectedProtocol protocol, bool confirmed)
+    {
+        uint8_t stored = static_cast<uint8_t>(protocol) | (confirmed ? PROTOCOL_CONFIRMED : 0);
+        this->protocol_pref_.save(&stored);
+        global_preferences->sync();
+        if (confirmed) {
+            ESP_LOGI(TAG, "Detected protocol %s", LOG_STR_ARG(DetectedProtocol_to_string(protocol)));
+            this->protocol_confirmed_ = true;
+        }
+    }
+
     void RATGDOComponent::loop()
     {
         if (!this->obstruction_from_status_) {
@@ -92,18 +251,115 @@ namespace ratgdo {
         } else {
             LOG_PIN("  Input Obstruction Pin: ", this->input_obst_pin_);
         }
+        ESP_LOGCONFIG(TAG, "  Warm boot: %s", YESNO(this->warm_boot_));
+#ifdef PROTOCOL_AUTO
+        ESP_LOGCONFIG(TAG, "  Protocol: auto, %s%s", LOG_STR_ARG(DetectedProtocol_to_string(this->detected_protocol_)),
+            this->protocol_confirmed_ ? "" : " (detecting)");
+#endif
+        ESP_LOGCONFIG(TAG, "  Coalesce window: %" PRIu32 "ms", this->coalesce_window_);
+        if (this->light_auto_off_ > 0) {
+            ESP_LOGCONFIG(TAG, "  Light auto off: %" PRIu32 "ms", this->light_auto_off_);
+        }
+        if (this->door_command_burst_ > 0) {
+            ESP_LOGCONFIG(TAG, "  Door command limit: %d starts, one back every %" PRIu32 "ms", this->door_command_burst_, this->door_command_refill_);
+        }
         this->protocol_->dump_config();
     }
 
+    void RATGDOComponent::on_shutdown()
+    {
+        this->update_state_times();
+        this->save_state_times();
+        if (!this->warm_boot_) {
+            global_preferences->sync();
+            return;
+        }
+        RATGDOSnapshot snapshot {
+            SNAPSHOT_MAGIC,
+            *this->door_position,
+            *this->openings,
+            *this->paired_total,
+            *this->paired_remotes,
+            *this->paired_keypads,
+            *this->paired_wall_controls,
+            *this->paired_accessories,
+            *this->door_state,
+            *this->light_state,
+            *this->lock_state,
+        };
+        this->snapshot_pref_.save(&snapshot);
+        global_preferences->sync();
+    }
+
+    bool RATGDOComponent::load_snapshot(RATGDOSnapshot& snapshot)
+    {
+        // RTC memory on ESP8266, so a power cycle never finds a snapshot. On
+        // ESP32 this is NVS and survives power loss, see the reset reason below.
+        this->snapshot_pref_ = global_preferences->make_preference<RATGDOSnapshot>(
+            fnv1_hash("ratgdo_snapshot") + this->output_gdo_pin_->get_pin(), false);
+        if (!this->snapshot_pref_.load(&snapshot) || snapshot.magic != SNAPSHOT_MAGIC) {
+            return false;
+        }
+
+        // only valid for the boot right after the shutdown that saved it
+        RATGDOSnapshot invalid {};
+        this->snapshot_pref_.save(&invalid);
+        global_preferences->sync();
+
+#ifdef USE_ESP32
+        // the door may have moved while the power was off
+        if (esp_reset_reason() != ESP_RST_SW) {
+            ESP_LOGD(TAG, "Not a software restart, doing a full sync");
+            return false;
+        }
+#endif
+
+        if (snapshot.door_state != DoorState::OPEN && snapshot.door_state != DoorState::CLOSED && snapshot.door_state != DoorState::STOPPED) {
+            ESP_LOGD(TAG, "Door was moving at shutdown, doing a full sync");
+            return false;
+        }
+        return true;
+    }
+
+    void RATGDOComponent::restore_snapshot(const RATGDOSnapshot& snapshot)
+    {
+        this->door_position = snapshot.door_position;
+        this->door_state = snapshot.door_state;
+        this->light_state = snapshot.light_state;
+        this->lock_state = snapshot.lock_state;
+        this->openings = snapshot.openings;
+        this->paired_total = snapshot.paired_total;
+        this->paired_remotes = snapshot.paired_remotes;
+        this->paired_keypads = snapshot.paired_keypads;
+        this->paired_wall_controls = snapshot.paired_wall_controls;
+        this->paired_accessories = snapshot.paired_accessories;
+        ESP_LOGD(TAG, "Warm boot, restored door state=%s at %" PRIu32 "ms", LOG_STR_ARG(DoorState_to_string(snapshot.door_state)), millis());
+
+        // sync only queries what is still unknown, which leaves the status query
+        // as the single verification on protocols that have one
+        this->query_status();
+        this->sync();
+    }
+
     void RATGDOComponent::received(const DoorState door_state)
     {
-        ESP_LOGD(TAG, "Door state=%s", DoorState_to_string(door_state));
+        ESP_LOGD(TAG, "Door state=%s", LOG_STR_ARG(DoorState_to_string(door_state)));
 
         auto prev_door_state = *this->door_state;
 
         if (prev_door_state == door_state) {
             return;
         }
+        if (door_state != DoorState::UNKNOWN) {
+            this->mark_boot_phase(BootPhase::FIRST_DOOR_STATE);
+        }
+
+        // any change means the opener is reporting again
+        cancel_timeout("travel_watchdog");
+        if (*this->door_fault) {
+            ESP_LOGI(TAG, "Door fault cleared");
+            this->door_fault = false;
+        }
 
         // opening duration calibration
         if (*this->opening_duration == 0) {
@@ -147,6 +403,7 @@ namespace ratgdo {
             if (*this->opening_duration != 0) {
                 this->schedule_door_position_sync();
             }
+            this->arm_travel_watchdog(door_state);
         } else if (door_state == DoorState::CLOSING) {
             // door started closing
             if (prev_door_state == DoorState::OPENING) {
@@ -162,13 +419,13 @@ namespace ratgdo {
             if (*this->closing_duration != 0) {
                 this->schedule_door_position_sync();
             }
+            this->arm_travel_watchdog(door_state);
         } else if (door_state == DoorState::STOPPED) {
             this->door_position_update();
             if (*this->door_position == DOOR_POSITION_UNKNOWN) {
                 this->door_position = 0.5; // best guess
             }
             this->cancel_position_sync_callbacks();
-            cancel_timeout("door_query_state");
         } else if (door_state == DoorState::OPEN) {
             this->door_position = 1.0;
             this->cancel_position_sync_callbacks();
@@ -186,12 +443,14 @@ namespace ratgdo {
         }
 
         this->door_state = door_state;
-        this->on_door_state_.trigger(door_state);
+        // a protocol may report from inside door_action(), let the command that
+        // caused it finish first
+        defer("reconcile_door_state", [=] { this->reconcile_door(); });
     }
 
     void RATGDOComponent::received(const LearnState learn_state)
     {
-        ESP_LOGD(TAG, "Learn state=%s", LearnState_to_string(learn_state));
+        ESP_LOGD(TAG, "Learn state=%s", LOG_STR_ARG(LearnState_to_string(learn_state)));
 
         if (*this->learn_state == learn_state) {
             return;
@@ -206,20 +465,22 @@ namespace ratgdo {
 
     void RATGDOComponent::received(const LightState light_state)
     {
-        ESP_LOGD(TAG, "Light state=%s", LightState_to_string(light_state));
+        ESP_LOGD(TAG, "Light state=%s", LOG_STR_ARG(LightState_to_string(light_state)));
         this->light_state = light_state;
+        this->reconcile_light();
     }
 
     void RATGDOComponent::received(const LockState lock_state)
     {
-        ESP_LOGD(TAG, "Lock state=%s", LockState_to_string(lock_state));
+        ESP_LOGD(TAG, "Lock state=%s", LOG_STR_ARG(LockState_to_string(lock_state)));
         this->lock_state = lock_state;
+        this->reconcile_lock();
     }
 
     void RATGDOComponent::received(const ObstructionState obstruction_state)
     {
         if (this->obstruction_from_status_) {
-            ESP_LOGD(TAG, "Obstruction: state=%s", ObstructionState_to_string(*this->obstruction_state));
+            ESP_LOGD(TAG, "Obstruction: state=%s", LOG_STR_ARG(ObstructionState_to_string(*this->obstruction_state)));
 
             this->obstruction_state = obstruction_state;
             // This isn't very fast to update, but its still better
@@ -230,19 +491,19 @@ namespace ratgdo {
 
     void RATGDOComponent::received(const MotorState motor_state)
     {
-        ESP_LOGD(TAG, "Motor: state=%s", MotorState_to_string(*this->motor_state));
+        ESP_LOGD(TAG, "Motor: state=%s", LOG_STR_ARG(MotorState_to_string(*this->motor_state)));
         this->motor_state = motor_state;
     }
 
     void RATGDOComponent::received(const ButtonState button_state)
     {
-        ESP_LOGD(TAG, "Button state=%s", ButtonState_to_string(*this->button_state));
+        ESP_LOGD(TAG, "Button state=%s", LOG_STR_ARG(ButtonState_to_string(*this->button_state)));
         this->button_state = button_state;
     }
 
     void RATGDOComponent::received(const MotionState motion_state)
     {
-        ESP_LOGD(TAG, "Motion: %s", MotionState_to_string(*this->motion_state));
+        ESP_LOGD(TAG, "Motion: %s", LOG_STR_ARG(MotionState_to_string(*this->motion_state)));
         this->motion_state = motion_state;
         if (motion_state == MotionState::DETECTED) {
             this->set_timeout("clear_motion", 3000, [=] {
@@ -257,8 +518,8 @@ namespace ratgdo {
     void RATGDOComponent::received(const LightAction light_action)
     {
         ESP_LOGD(TAG, "Light cmd=%s state=%s",
-            LightAction_to_string(light_action),
-            LightState_to_string(*this->light_state));
+            LOG_STR_ARG(LightAction_to_string(light_action)),
+            LOG_STR_ARG(LightState_to_string(*this->light_state)));
         if (light_action == LightAction::OFF) {
             this->light_state = LightState::OFF;
         } else if (light_action == LightAction::ON) {
@@ -266,6 +527,7 @@ namespace ratgdo {
         } else if (light_action == LightAction::TOGGLE) {
             this->light_state = light_state_toggle(*this->light_state);
         }
+        this->reconcile_light();
     }
 
     void RATGDOComponent::received(const Openings openings)
@@ -280,7 +542,7 @@ namespace ratgdo {
 
     void RATGDOComponent::received(const PairedDeviceCount pdc)
     {
-        ESP_LOGD(TAG, "Paired device count, kind=%s count=%d", PairedDevice_to_string(pdc.kind), pdc.count);
+        ESP_LOGD(TAG, "Paired device count, kind=%s count=%d", LOG_STR_ARG(PairedDevice_to_string(pdc.kind)), pdc.count);
 
         if (pdc.kind == PairedDevice::ALL) {
             this->paired_total = pdc.count;
@@ -302,7 +564,208 @@ namespace ratgdo {
 
     void RATGDOComponent::received(const BatteryState battery_state)
     {
-        ESP_LOGD(TAG, "Battery state=%s", BatteryState_to_string(battery_state));
+        ESP_LOGD(TAG, "Battery state=%s", LOG_STR_ARG(BatteryState_to_string(battery_state)));
+    }
+
+    void RATGDOComponent::received(const LinkState link_state)
+    {
+        auto prev_link_state = *this->link_state;
+        if (prev_link_state == link_state) {
+            return;
+        }
+        ESP_LOGD(TAG, "Link state=%s", LOG_STR_ARG(LinkState_to_string(link_state)));
+        this->link_state = link_state;
+
+        if (link_state == LinkState::CONNECTED) {
+#ifdef PROTOCOL_AUTO
+            if (!this->protocol_confirmed_) {
+                cancel_timeout("protocol_detect");
+                this->save_protocol(this->detected_protocol_, true);
+            }
+#endif
+            cancel_timeout("resync");
+            this->resync_delay_ = RESYNC_DELAY_MIN;
+            if (prev_link_state == LinkState::DISCONNECTED || *this->sync_failed) {
+                // the opener came back (breaker reset, cable reseated), refresh everything
+                this->sync_failed = false;
+                this->query_status();
+                this->sync();
+            }
+        } else if (prev_link_state == LinkState::CONNECTED || prev_link_state == LinkState::UNKNOWN) {
+            this->resync_delay_ = RESYNC_DELAY_MIN;
+            this->schedule_resync();
+        }
+    }
+
+    void RATGDOComponent::schedule_resync()
+    {
+        ESP_LOGD(TAG, "Link not healthy, probing opener in %" PRIu32 "ms", this->resync_delay_);
+        set_timeout("resync", this->resync_delay_, [=] {
+            if (*this->link_state == LinkState::CONNECTED) {
+                return;
+            }
+            this->query_status();
+            this->resync_delay_ = std::min(this->resync_delay_ * 2, RESYNC_DELAY_MAX);
+            this->schedule_resync();
+        });
+    }
+
+    void RATGDOComponent::arm_travel_watchdog(DoorState door_state)
+    {
+        auto duration = door_state == DoorState::OPENING ? *this->opening_duration : *this->closing_duration;
+        // a move from part way arrives sooner, a full travel is the upper bound
+        uint32_t timeout = duration > 0 ? duration * 1000 + TRAVEL_MARGIN : TRAVEL_TIMEOUT_UNLEARNED;
+        set_timeout("travel_watchdog", timeout, [=] { this->check_travel(door_state, 0); });
+    }
+
+    void RATGDOComponent::check_travel(DoorState door_state, uint8_t queries)
+    {
+        if (*this->door_state != door_state) {
+            return;
+        }
+        if (queries >= TRAVEL_MAX_QUERIES) {
+            ESP_LOGW(TAG, "Door still %s after %d status queries, flagging a door fault",
+                LOG_STR_ARG(DoorState_to_string(door_state)), queries);
+            cancel_retry("position_sync_while_moving");
+            if (this->door_target_.active) {
+                this->door_target_done(false);
+            }
+            this->door_fault = true;
+            return;
+        }
+        ESP_LOGD(TAG, "Door should have finished %s, querying status", LOG_STR_ARG(DoorState_to_string(door_state)));
+        this->query_status();
+        set_timeout("travel_watchdog", TRAVEL_QUERY_INTERVAL, [=] { this->check_travel(door_state, queries + 1); });
+    }
+
+    void RATGDOComponent::mark_boot_phase(BootPhase phase)
+    {
+        auto index = static_cast<uint8_t>(phase);
+        if (this->boot_phases_[index] != 0) {
+            return;
+        }
+        auto at = millis();
+        this->boot_phases_[index] = at;
+        ESP_LOG1(TAG, "Boot phase %s at %" PRIu32 "ms", LOG_STR_ARG(BootPhase_to_string(phase)), at);
+        auto type = static_cast<RATGDOSensorType>(RATGDO_BOOT_SETUP + index);
+        defer([=] { this->sensors_[type](at); });
+        if (phase == BootPhase::SYNCED || phase == BootPhase::SYNC_FAILED) {
+            this->log_boot_phases();
+        }
+    }
+
+    void RATGDOComponent::on_traffic()
+    {
+        if (!this->sync_on_traffic_) {
+            return;
+        }
+        ESP_LOGD(TAG, "Traffic on the line, not a dry contact opener, syncing");
+        this->sync_on_traffic_ = false;
+        set_timeout(SYNC_DELAY, [=] { this->sync(); });
+    }
+
+    void RATGDOComponent::log_boot_phases()
+    {
+        // 0 is a phase that wasn't reached
+        const auto& at = this->boot_phases_;
+        ESP_LOGI(TAG, "Boot: setup %" PRIu32 "ms, protocol %" PRIu32 "ms, first byte %" PRIu32 "ms, first frame %" PRIu32 "ms, "
+                      "door state %" PRIu32 "ms, synced %" PRIu32 "ms, sync failed %" PRIu32 "ms",
+            at[0], at[1], at[2], at[3], at[4], at[5], at[6]);
+    }
+
+    void RATGDOComponent::init_state_times()
+    {
+        this->state_time_pref_ = global_preferences->make_preference<StateTimeSave>(
+            fnv1_hash("ratgdo_state_time") + this->output_gdo_pin_->get_pin());
+        StateTimeSave saved;
+        if (this->state_time_pref_.load(&saved) && saved.magic == STATE_TIME_MAGIC) {
+            for (uint8_t i = 0; i < STATE_TIME_COUNT; i++) {
+                this->state_timers_[i].time.total = saved.totals[i];
+            }
+        }
+
+        auto now = millis();
+        this->state_hour_start_ = now;
+        for (auto& timer : this->state_timers_) {
+            timer.update(now);
+        }
+        this->door_state.subscribe([=](DoorState state) {
+            this->state_timers_[STATE_TIME_DOOR_OPEN].set(state != DoorState::CLOSED && state != DoorState::UNKNOWN, millis());
+        });
+        this->light_state.subscribe([=](LightState state) {
+            this->state_timers_[STATE_TIME_LIGHT_ON].set(state == LightState::ON, millis());
+        });
+        this->motor_state.subscribe([=](MotorState state) {
+            this->state_timers_[STATE_TIME_MOTOR_ON].set(state == MotorState::ON, millis());
+        });
+        this->obstruction_state.subscribe([=](ObstructionState state) {
+            this->state_timers_[STATE_TIME_OBSTRUCTED].set(state == ObstructionState::OBSTRUCTED, millis());
+        });
+
+        set_interval("state_time", STATE_TIME_UPDATE_INTERVAL, [=] { this->update_state_times(); });
+        // rate limited, flash wears out
+        set_interval("state_time_save", STATE_TIME_SAVE_INTERVAL, [=] { this->save_state_times(); });
+    }
+
+    void RATGDOComponent::update_state_times()
+    {
+        auto now = millis();
+        bool new_hour = now - this->state_hour_start_ >= STATE_TIME_HOUR;
+        for (uint8_t i = 0; i < STATE_TIME_COUNT; i++) {
+            auto& timer = this->state_timers_[i];
+            timer.update(now);
+            bool changed = timer.take_changed();
+            if (new_hour) {
+                timer.time.next_hour();
+                changed = true;
+            }
+            if (changed) {
+                this->state_times_dirty_ = true;
+                this->publish_state_time(static_cast<StateTimeIndex>(i));
+            }
+        }
+        if (new_hour) {
+            this->state_hour_start_ += STATE_TIME_HOUR;
+        }
+    }
+
+    void RATGDOComponent::save_state_times()
+    {
+        if (!this->state_times_dirty_) {
+            return;
+        }
+        StateTimeSave saved { STATE_TIME_MAGIC };
+        for (uint8_t i = 0; i < STATE_TIME_COUNT; i++) {
+            saved.totals[i] = this->state_timers_[i].time.total;
+        }
+        this->state_time_pref_.save(&saved);
+        this->state_times_dirty_ = false;
+    }
+
+    void RATGDOComponent::publish_state_time(StateTimeIndex index)
+    {
+        const auto& time = this->state_timers_[index].time;
+        auto type = RATGDO_DOOR_OPEN_TIME + 2 * index;
+        this->sensors_[type](time.total);
+        this->sensors_[type + 1](time.last_day());
+    }
+
+    void RATGDOComponent::report_memory(const char* point)
+    {
+#ifdef USE_ESP8266
+        this->free_heap = ESP.getFreeHeap();
+        this->largest_free_block = ESP.getMaxFreeBlockSize();
+#elif defined(USE_ESP32)
+        this->free_heap = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+        this->largest_free_block = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+#endif
+        const auto& stats = alloc_stats();
+        this->heap_used = stats.current;
+        this->heap_used_peak = stats.peak;
+        if (point != nullptr) {
+            ESP_LOGD(TAG, "Memory at %s: free %" PRIu32 ", largest block %" PRIu32 ", ratgdo %" PRIu32 " (peak %" PRIu32 ", %" PRIu32 " allocations)",
+                point, *this->free_heap, *this->largest_free_block, *this->heap_used, *this->heap_used_peak, stats.allocations);
+        }
     }
 
     void RATGDOComponent::schedule_door_position_sync(float update_period)
@@ -354,8 +817,9 @@ namespace ratgdo {
 
     /*************************** OBSTRUCTION DETECTION ***************************/
 
-    void RATGDOComponent::obstruction_loop()
+    void RATGDO_HOT RATGDOComponent::obstruction_loop()
     {
+        RATGDO_PROFILE("obstruction_loop");
         long current_millis = millis();
         static unsigned long last_millis = 0;
         static unsigned long last_asleep = 0;
@@ -427,114 +891,200 @@ namespace ratgdo {
         // dry contact protocol:
         // needed to trigger the intial state of the limit switch sensors
         // ideally this would be in drycontact::sync
-#ifdef PROTOCOL_DRYCONTACT
-        this->protocol_->set_open_limit(this->dry_contact_open_sensor_->state);
-        this->protocol_->set_close_limit(this->dry_contact_close_sensor_->state);
-#endif
+        if (this->dry_contact_open_sensor_ != nullptr && this->dry_contact_close_sensor_ != nullptr) {
+            this->protocol_->set_open_limit(this->dry_contact_open_sensor_->state);
+            this->protocol_->set_close_limit(this->dry_contact_close_sensor_->state);
+        }
     }
 
     void RATGDOComponent::door_open()
     {
-        if (*this->door_state == DoorState::OPENING) {
-            return; // gets ignored by opener
-        }
-
-        this->door_action(DoorAction::OPEN);
-
-        if (*this->opening_duration > 0) {
-            // query state in case we don't get a status message
-            set_timeout("door_query_state", (*this->opening_duration + 2) * 1000, [=]() {
-                if (*this->door_state != DoorState::OPEN && *this->door_state != DoorState::STOPPED) {
-                    this->received(DoorState::OPEN); // probably missed a status mesage, assume it's open
-                    this->query_status(); // query in case we're wrong and it's stopped
-                }
-            });
-        }
+        this->request_door({ DoorAction::OPEN });
     }
 
     void RATGDOComponent::door_close()
     {
-        if (*this->door_state == DoorState::CLOSING) {
-            return; // gets ignored by opener
-        }
+        this->request_door({ DoorAction::CLOSE });
+    }
 
-        if (*this->door_state == DoorState::OPENING) {
-            // have to stop door first, otherwise close command is ignored
-            this->door_action(DoorAction::STOP);
-            this->on_door_state_([=](DoorState s) {
-                if (s == DoorState::STOPPED) {
-                    this->door_action(DoorAction::CLOSE);
-                } else {
-                    ESP_LOGW(TAG, "Door did not stop, ignoring close command");
-                }
-            });
-            return;
-        }
+    void RATGDOComponent::door_stop()
+    {
+        this->request_door({ DoorAction::STOP });
+    }
 
-        this->door_action(DoorAction::CLOSE);
+    void RATGDOComponent::door_toggle()
+    {
+        this->request_door({ DoorAction::TOGGLE });
+    }
 
-        if (*this->closing_duration > 0) {
-            // query state in case we don't get a status message
-            set_timeout("door_query_state", (*this->closing_duration + 2) * 1000, [=]() {
-                if (*this->door_state != DoorState::CLOSED && *this->door_state != DoorState::STOPPED) {
-                    this->received(DoorState::CLOSED); // probably missed a status mesage, assume it's closed
-                    this->query_status(); // query in case we're wrong and it's stopped
-                }
-            });
+    bool RATGDOComponent::door_action(DoorAction action)
+    {
+        // a close always goes out, being throttled must never leave the door open
+        bool opens = action == DoorAction::OPEN || (action == DoorAction::TOGGLE && *this->door_state == DoorState::CLOSED);
+        if (action != DoorAction::STOP && !this->take_door_token(opens)) {
+            this->throttled_commands = *this->throttled_commands + 1;
+            ESP_LOGW(TAG, "Door %s throttled, too many motor starts (%" PRIu32 " throttled so far)",
+                LOG_STR_ARG(DoorAction_to_string(action)), *this->throttled_commands);
+            return false;
         }
+        this->protocol_->door_action(action);
+        return true;
     }
 
-    void RATGDOComponent::door_stop()
+    // Every motor start draws from a bucket of door_command_burst_ tokens. One
+    // token comes back per door_command_refill_ of motor idle time, so time spent
+    // running doesn't count towards cooling down. Only starts that open the door
+    // are refused when the bucket is empty, stop is never counted.
+    bool RATGDOComponent::take_door_token(bool may_refuse)
     {
-        if (*this->door_state != DoorState::OPENING && *this->door_state != DoorState::CLOSING) {
-            ESP_LOGW(TAG, "The door is not moving.");
-            return;
+        if (this->door_command_burst_ == 0) {
+            return true;
+        }
+        this->refill_door_tokens();
+        if (this->door_tokens_ == 0) {
+            return !may_refuse;
+        }
+        this->door_tokens_--;
+        if (this->door_tokens_ == 0) {
+            this->door_throttled = true;
+            set_timeout("door_throttle", this->door_command_refill_ - this->door_token_idle_, [=] { this->refill_door_tokens(); });
         }
-        this->door_action(DoorAction::STOP);
+        return true;
     }
 
-    void RATGDOComponent::door_toggle()
+    void RATGDOComponent::refill_door_tokens()
     {
-        this->door_action(DoorAction::TOGGLE);
+        auto now = millis();
+        uint32_t motor_ms = this->motor_on_ms_ + (this->motor_running_ ? now - this->motor_on_since_ : 0);
+        this->door_token_idle_ += (now - this->door_token_checked_) - (motor_ms - this->door_token_motor_ms_);
+        this->door_token_checked_ = now;
+        this->door_token_motor_ms_ = motor_ms;
+        while (this->door_token_idle_ >= this->door_command_refill_ && this->door_tokens_ < this->door_command_burst_) {
+            this->door_token_idle_ -= this->door_command_refill_;
+            this->door_tokens_++;
+        }
+        if (this->door_tokens_ == this->door_command_burst_) {
+            this->door_token_idle_ = 0;
+        }
+        if (this->door_tokens_ > 0) {
+            this->door_throttled = false;
+        } else {
+            // the motor was running, try again once it could have earned a token
+            set_timeout("door_throttle", this->door_command_refill_ - this->door_token_idle_, [=] { this->refill_door_tokens(); });
+        }
     }
 
-    void RATGDOComponent::door_action(DoorAction action)
+    // motor state only comes from Sec+2, door travel counts for the others
+    void RATGDOComponent::update_motor_running()
     {
-        this->protocol_->door_action(action);
+        bool running = *this->motor_state == MotorState::ON || *this->door_state == DoorState::OPENING || *this->door_state == DoorState::CLOSING;
+        if (running == this->motor_running_) {
+            return;
+        }
+        auto now = millis();
+        if (running) {
+            this->motor_on_since_ = now;
+        } else {
+            this->motor_on_ms_ += now - this->motor_on_since_;
+        }
+        this->motor_running_ = running;
     }
 
     void RATGDOComponent::door_move_to_position(float position)
     {
-        if (*this->door_state == DoorState::OPENING || *this->door_state == DoorState::CLOSING) {
-            this->door_action(DoorAction::STOP);
-            this->on_door_state_([=](DoorState s) {
-                if (s == DoorState::STOPPED) {
-                    this->door_move_to_position(position);
+        this->request_door({ DoorAction::UNKNOWN, position });
+    }
+
+    // The first open/close of a burst runs right away and opens a window. Those
+    // arriving inside the window only replace each other, the last one runs when
+    // the window ends, so a burst costs at most two commands on the bus. Stop,
+    // toggle and position aren't idempotent or can't wait and always run now.
+    void RATGDOComponent::request_door(DoorRequest request)
+    {
+        bool idempotent = request.action == DoorAction::OPEN || request.action == DoorAction::CLOSE;
+        if (this->coalesce_window_ == 0 || !idempotent) {
+            if (this->door_request_pending_) {
+                // keep the order, a stop wins over whatever was still waiting
+                this->door_request_pending_ = false;
+                if (request.action != DoorAction::STOP) {
+                    this->run_door_request(this->door_request_);
                 }
-            });
+            }
+            this->run_door_request(request);
             return;
         }
-
-        auto delta = position - *this->door_position;
-        if (delta == 0) {
-            ESP_LOGD(TAG, "Door is already at position %.2f", position);
+        if (this->coalescing_) {
+            if (this->door_request_pending_) {
+                this->coalesced_commands = *this->coalesced_commands + 1;
+                ESP_LOGD(TAG, "Coalesced door request, %" PRIu32 " so far", *this->coalesced_commands);
+            }
+            this->door_request_ = request;
+            this->door_request_pending_ = true;
             return;
         }
+        this->coalescing_ = true;
+        set_timeout("door_coalesce", this->coalesce_window_, [=] { this->end_coalesce_window(); });
+        this->run_door_request(request);
+    }
 
-        auto duration = delta > 0 ? *this->opening_duration : -*this->closing_duration;
-        if (duration == 0) {
-            ESP_LOGW(TAG, "I don't know duration, ignoring move to position");
+    void RATGDOComponent::end_coalesce_window()
+    {
+        if (!this->door_request_pending_) {
+            this->coalescing_ = false;
             return;
         }
+        // the trailing request opens the next window, a burst that keeps going stays coalesced
+        this->door_request_pending_ = false;
+        set_timeout("door_coalesce", this->coalesce_window_, [=] { this->end_coalesce_window(); });
+        this->run_door_request(this->door_request_);
+    }
+
+    // An obstruction wins over anything still queued to move the door: the
+    // reconciler target with its move_to_position stop, a coalesced request
+    // and whatever the protocol hasn't sent yet. The opener handles the
+    // obstruction itself, nothing is sent.
+    void RATGDOComponent::preempt_door_commands()
+    {
+        auto start = micros();
+        bool had_target = this->door_target_.active;
+        if (had_target) {
+            // cancelled on purpose, not a failure to get there
+            this->clear_door_target();
+        }
+        this->door_request_pending_ = false;
+        this->protocol_->call(protocol::FlushDoorCommands {});
+        ESP_LOGD(TAG, "Obstruction, door commands flushed in %" PRIu32 "us", micros() - start);
+        if (had_target) {
+            ESP_LOGD(TAG, "Door target %s cancelled by obstruction after %d commands",
+                LOG_STR_ARG(DoorTarget_to_string(this->door_target_.value)), this->door_target_.commands);
+        }
+    }
 
-        auto operation_time = 1000 * duration * delta;
-        this->door_move_delta = delta;
-        ESP_LOGD(TAG, "Moving to position %.2f in %.1fs", position, operation_time / 1000.0);
-
-        this->door_action(delta > 0 ? DoorAction::OPEN : DoorAction::CLOSE);
-        set_timeout("move_to_position", operation_time, [=] {
-            this->door_action(DoorAction::STOP);
-        });
+    void RATGDOComponent::run_door_request(const DoorRequest& request)
+    {
+        switch (request.action) {
+        case DoorAction::OPEN:
+            this->set_door_target(DoorTarget::OPEN);
+            break;
+        case DoorAction::CLOSE:
+            this->set_door_target(DoorTarget::CLOSED);
+            break;
+        case DoorAction::STOP:
+            if (*this->door_state != DoorState::OPENING && *this->door_state != DoorState::CLOSING && !this->door_target_.active) {
+                ESP_LOGW(TAG, "The door is not moving.");
+                return;
+            }
+            this->set_door_target(DoorTarget::STOPPED);
+            break;
+        case DoorAction::TOGGLE:
+            // a toggle has no target of its own, it replaces whatever was pending
+            this->clear_door_target();
+            this->door_action(DoorAction::TOGGLE);
+            break;
+        default:
+            this->set_door_target(DoorTarget::POSITION, request.position);
+            break;
+        }
     }
 
     void RATGDOComponent::cancel_position_sync_callbacks()
@@ -552,20 +1102,22 @@ namespace ratgdo {
 
     void RATGDOComponent::light_on()
     {
-        this->light_state = LightState::ON;
-        this->protocol_->light_action(LightAction::ON);
+        this->set_light_target(LightState::ON);
     }
 
     void RATGDOComponent::light_off()
     {
-        this->light_state = LightState::OFF;
-        this->protocol_->light_action(LightAction::OFF);
+        this->set_light_target(LightState::OFF);
     }
 
     void RATGDOComponent::light_toggle()
     {
-        this->light_state = light_state_toggle(*this->light_state);
-        this->protocol_->light_action(LightAction::TOGGLE);
+        auto current = this->light_target_.active ? this->light_target_.value : *this->light_state;
+        if (current == LightState::UNKNOWN) {
+            this->protocol_->light_action(LightAction::TOGGLE);
+            return;
+        }
+        this->set_light_target(light_state_toggle(current));
     }
 
     LightState RATGDOComponent::get_light_state() const
@@ -576,20 +1128,281 @@ namespace ratgdo {
     // Lock functions
     void RATGDOComponent::lock()
     {
-        this->lock_state = LockState::LOCKED;
-        this->protocol_->lock_action(LockAction::LOCK);
+        this->set_lock_target(LockState::LOCKED);
     }
 
     void RATGDOComponent::unlock()
     {
-        this->lock_state = LockState::UNLOCKED;
-        this->protocol_->lock_action(LockAction::UNLOCK);
+        this->set_lock_target(LockState::UNLOCKED);
     }
 
     void RATGDOComponent::lock_toggle()
     {
-        this->lock_state = lock_state_toggle(*this->lock_state);
-        this->protocol_->lock_action(LockAction::TOGGLE);
+        auto current = this->lock_target_.active ? this->lock_target_.value : *this->lock_state;
+        if (current == LockState::UNKNOWN) {
+            this->protocol_->lock_action(LockAction::TOGGLE);
+            return;
+        }
+        this->set_lock_target(lock_state_toggle(current));
+    }
+
+    /*************************** RECONCILER ***************************/
+
+    // Entities only set a desired state, the reconciler issues whatever is still
+    // needed to get there. A command stays in flight until the opener reports the
+    // state it leads to, or it times out, so rapid input moves the target instead
+    // of queueing up commands.
+
+    static bool door_command_reached(DoorAction action, DoorState state)
+    {
+        switch (action) {
+        case DoorAction::OPEN:
+            return state == DoorState::OPENING || state == DoorState::OPEN;
+        case DoorAction::CLOSE:
+            return state == DoorState::CLOSING || state == DoorState::CLOSED;
+        case DoorAction::STOP:
+            return state == DoorState::STOPPED || state == DoorState::OPEN || state == DoorState::CLOSED;
+        default:
+            return true;
+        }
+    }
+
+    void RATGDOComponent::set_door_target(DoorTarget target, float position)
+    {
+        auto& door = this->door_target_;
+        if (door.active) {
+            ESP_LOGD(TAG, "Door target %s superseded by %s", LOG_STR_ARG(DoorTarget_to_string(door.value)), LOG_STR_ARG(DoorTarget_to_string(target)));
+        }
+        if (this->door_position_move_) {
+            cancel_timeout("move_to_position");
+            this->door_position_move_ = false;
+        }
+        door.value = target;
+        door.active = true;
+        door.since = millis();
+        door.commands = 0;
+        this->door_target_position_ = position;
+        this->reconcile_door();
+    }
+
+    void RATGDOComponent::clear_door_target()
+    {
+        if (this->door_position_move_) {
+            cancel_timeout("move_to_position");
+            this->door_position_move_ = false;
+        }
+        this->door_target_.active = false;
+        cancel_timeout("reconcile_door");
+    }
+
+    void RATGDOComponent::door_target_done(bool reached)
+    {
+        auto& door = this->door_target_;
+        if (reached) {
+            ESP_LOGD(TAG, "Door target %s reached in %" PRIu32 "ms, %d commands",
+                LOG_STR_ARG(DoorTarget_to_string(door.value)), millis() - door.since, door.commands);
+        } else {
+            ESP_LOGW(TAG, "Door target %s not reached after %d commands, giving up",
+                LOG_STR_ARG(DoorTarget_to_string(door.value)), door.commands);
+        }
+        this->clear_door_target();
+    }
+
+    void RATGDOComponent::reconcile_door()
+    {
+        auto& door = this->door_target_;
+        if (!door.active) {
+            return;
+        }
+        auto state = *this->door_state;
+
+        if (door.command_at != 0) {
+            if (!door_command_reached(door.command, state)) {
+                if (millis() - door.command_at < DOOR_COMMAND_TIMEOUT) {
+                    return; // still waiting on the opener
+                }
+                ESP_LOGW(TAG, "Door did not respond to %s", LOG_STR_ARG(DoorAction_to_string(door.command)));
+                if (this->door_position_move_) {
+                    cancel_timeout("move_to_position");
+                    this->door_position_move_ = false;
+                }
+            }
+            door.command_at = 0;
+        }
+
+        bool moving = state == DoorState::OPENING || state == DoorState::CLOSING;
+        switch (door.value) {
+        case DoorTarget::OPEN:
+            if (state == DoorState::OPEN) {
+                this->door_target_done(true);
+            } else if (state != DoorState::OPENING) {
+                this->issue_door_command(DoorAction::OPEN);
+            }
+            break;
+        case DoorTarget::CLOSED:
+            if (state == DoorState::CLOSED) {
+                this->door_target_done(true);
+            } else if (state == DoorState::OPENING) {
+                // close is ignored while opening, stop first
+                this->issue_door_command(DoorAction::STOP);
+            } else if (state != DoorState::CLOSING) {
+                this->issue_door_command(DoorAction::CLOSE);
+            }
+            break;
+        case DoorTarget::STOPPED:
+            if (!moving) {
+                this->door_target_done(true);
+            } else {
+                this->issue_door_command(DoorAction::STOP);
+            }
+            break;
+        case DoorTarget::POSITION: {
+            if (moving) {
+                // a timed move only works from standstill
+                if (!this->door_position_move_) {
+                    this->issue_door_command(DoorAction::STOP);
+                }
+                break;
+            }
+            if (this->door_position_move_) {
+                this->door_target_done(true);
+                break;
+            }
+            auto delta = this->door_target_position_ - *this->door_position;
+            if (delta == 0) {
+                this->door_target_done(true);
+                break;
+            }
+            auto duration = delta > 0 ? *this->opening_duration : -*this->closing_duration;
+            if (duration == 0) {
+                ESP_LOGW(TAG, "I don't know duration, ignoring move to position");
+                this->clear_door_target();
+                break;
+            }
+            auto operation_time = 1000 * duration * delta;
+            this->door_move_delta = delta;
+            ESP_LOGD(TAG, "Moving to position %.2f in %.1fs", this->door_target_position_, operation_time / 1000.0);
+            this->issue_door_command(delta > 0 ? DoorAction::OPEN : DoorAction::CLOSE);
+            if (this->door_target_.command_at != 0) {
+                this->door_position_move_ = true;
+                set_timeout("move_to_position", operation_time, [=] {
+                    this->door_action(DoorAction::STOP);
+                });
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    void RATGDOComponent::issue_door_command(DoorAction action)
+    {
+        auto& door = this->door_target_;
+        if (door.commands >= MAX_TARGET_COMMANDS) {
+            this->door_target_done(false);
+            return;
+        }
+        // in flight before the protocol runs, it may report the new state right away
+        door.commands++;
+        door.command = action;
+        door.command_at = millis();
+        set_timeout("reconcile_door", DOOR_COMMAND_TIMEOUT, [=] { this->reconcile_door(); });
+        if (!this->door_action(action)) {
+            this->door_target_done(false);
+        }
+    }
+
+    void RATGDOComponent::set_light_target(LightState target)
+    {
+        auto& light = this->light_target_;
+        light.value = target;
+        light.active = true;
+        light.since = millis();
+        light.commands = 0;
+        this->reconcile_light();
+    }
+
+    void RATGDOComponent::reconcile_light()
+    {
+        auto& light = this->light_target_;
+        if (!light.active) {
+            return;
+        }
+        auto state = *this->light_state;
+
+        if (light.command_at != 0) {
+            auto expected = light.command == LightAction::ON ? LightState::ON : LightState::OFF;
+            if (state != expected && millis() - light.command_at < this->protocol_->traits().get_command_timeout()) {
+                return; // still waiting on the opener
+            }
+            light.command_at = 0;
+        }
+
+        if (state == light.value) {
+            ESP_LOGD(TAG, "Light target %s reached in %" PRIu32 "ms, %d commands",
+                LOG_STR_ARG(LightState_to_string(light.value)), millis() - light.since, light.commands);
+            light.active = false;
+            cancel_timeout("reconcile_light");
+            return;
+        }
+        if (light.commands >= MAX_TARGET_COMMANDS) {
+            ESP_LOGW(TAG, "Light target %s not reached after %d commands, giving up",
+                LOG_STR_ARG(LightState_to_string(light.value)), light.commands);
+            light.active = false;
+            return;
+        }
+        light.commands++;
+        light.command = light.value == LightState::ON ? LightAction::ON : LightAction::OFF;
+        light.command_at = millis();
+        this->protocol_->light_action(light.command);
+        set_timeout("reconcile_light", this->protocol_->traits().get_command_timeout(), [=] { this->reconcile_light(); });
+    }
+
+    void RATGDOComponent::set_lock_target(LockState target)
+    {
+        auto& lock = this->lock_target_;
+        lock.value = target;
+        lock.active = true;
+        lock.since = millis();
+        lock.commands = 0;
+        this->reconcile_lock();
+    }
+
+    void RATGDOComponent::reconcile_lock()
+    {
+        auto& lock = this->lock_target_;
+        if (!lock.active) {
+            return;
+        }
+        auto state = *this->lock_state;
+
+        if (lock.command_at != 0) {
+            auto expected = lock.command == LockAction::LOCK ? LockState::LOCKED : LockState::UNLOCKED;
+            if (state != expected && millis() - lock.command_at < this->protocol_->traits().get_command_timeout()) {
+                return; // still waiting on the opener
+            }
+            lock.command_at = 0;
+        }
+
+        if (state == lock.value) {
+            ESP_LOGD(TAG, "Lock target %s reached in %" PRIu32 "ms, %d commands",
+                LOG_STR_ARG(LockState_to_string(lock.value)), millis() - lock.since, lock.commands);
+            lock.active = false;
+            cancel_timeout("reconcile_lock");
+            return;
+        }
+        if (lock.commands >= MAX_TARGET_COMMANDS) {
+            ESP_LOGW(TAG, "Lock target %s not reached after %d commands, giving up",
+                LOG_STR_ARG(LockState_to_string(lock.value)), lock.commands);
+            lock.active = false;
+            return;
+        }
+        lock.commands++;
+        lock.command = lock.value == LockState::LOCKED ? LockAction::LOCK : LockAction::UNLOCK;
+        lock.command_at = millis();
+        this->protocol_->lock_action(lock.command);
+        set_timeout("reconcile_lock", this->protocol_->traits().get_command_timeout(), [=] { this->reconcile_lock(); });
     }
 
     // Learn functions
@@ -620,30 +1433,6 @@ namespace ratgdo {
     {
         this->closing_duration.subscribe([=](float state) { defer("closing_duration", [=] { f(state); }); });
     }
-    void RATGDOComponent::subscribe_openings(std::function<void(uint16_t)>&& f)
-    {
-        this->openings.subscribe([=](uint16_t state) { defer("openings", [=] { f(state); }); });
-    }
-    void RATGDOComponent::subscribe_paired_devices_total(std::function<void(uint16_t)>&& f)
-    {
-        this->paired_total.subscribe([=](uint16_t state) { defer("paired_total", [=] { f(state); }); });
-    }
-    void RATGDOComponent::subscribe_paired_remotes(std::function<void(uint16_t)>&& f)
-    {
-        this->paired_remotes.subscribe([=](uint16_t state) { defer("paired_remotes", [=] { f(state); }); });
-    }
-    void RATGDOComponent::subscribe_paired_keypads(std::function<void(uint16_t)>&& f)
-    {
-        this->paired_keypads.subscribe([=](uint16_t state) { defer("paired_keypads", [=] { f(state); }); });
-    }
-    void RATGDOComponent::subscribe_paired_wall_controls(std::function<void(uint16_t)>&& f)
-    {
-        this->paired_wall_controls.subscribe([=](uint16_t state) { defer("paired_wall_controls", [=] { f(state); }); });
-    }
-    void RATGDOComponent::subscribe_paired_accessories(std::function<void(uint16_t)>&& f)
-    {
-        this->paired_accessories.subscribe([=](uint16_t state) { defer("paired_accessories", [=] { f(state); }); });
-    }
     void RATGDOComponent::subscribe_door_state(std::function<void(DoorState, float)>&& f)
     {
         this->door_state.subscribe([=](DoorState state) {
@@ -661,22 +1450,6 @@ namespace ratgdo {
     {
         this->lock_state.subscribe([=](LockState state) { defer("lock_state", [=] { f(state); }); });
     }
-    void RATGDOComponent::subscribe_obstruction_state(std::function<void(ObstructionState)>&& f)
-    {
-        this->obstruction_state.subscribe([=](ObstructionState state) { defer("obstruction_state", [=] { f(state); }); });
-    }
-    void RATGDOComponent::subscribe_motor_state(std::function<void(MotorState)>&& f)
-    {
-        this->motor_state.subscribe([=](MotorState state) { defer("motor_state", [=] { f(state); }); });
-    }
-    void RATGDOComponent::subscribe_button_state(std::function<void(ButtonState)>&& f)
-    {
-        this->button_state.subscribe([=](ButtonState state) { defer("button_state", [=] { f(state); }); });
-    }
-    void RATGDOComponent::subscribe_motion_state(std::function<void(MotionState)>&& f)
-    {
-        this->motion_state.subscribe([=](MotionState state) { defer("motion_state", [=] { f(state); }); });
-    }
     void RATGDOComponent::subscribe_sync_failed(std::function<void(bool)>&& f)
     {
         this->sync_failed.subscribe(std::move(f));
@@ -686,6 +1459,112 @@ namespace ratgdo {
         this->learn_state.subscribe([=](LearnState state) { defer("learn_state", [=] { f(state); }); });
     }
 
+    void RATGDOComponent::register_sensor(RATGDOSensorType type, void* sensor, SensorDispatch::Publish publish)
+    {
+        if (this->sensors_[type].empty()) {
+            switch (type) {
+            case RATGDO_OPENINGS:
+                this->subscribe_sensor(this->openings, type, "openings");
+                break;
+            case RATGDO_PAIRED_DEVICES_TOTAL:
+                this->subscribe_sensor(this->paired_total, type, "paired_total");
+                break;
+            case RATGDO_PAIRED_REMOTES:
+                this->subscribe_sensor(this->paired_remotes, type, "paired_remotes");
+                break;
+            case RATGDO_PAIRED_KEYPADS:
+                this->subscribe_sensor(this->paired_keypads, type, "paired_keypads");
+                break;
+            case RATGDO_PAIRED_WALL_CONTROLS:
+                this->subscribe_sensor(this->paired_wall_controls, type, "paired_wall_controls");
+                break;
+            case RATGDO_PAIRED_ACCESSORIES:
+                this->subscribe_sensor(this->paired_accessories, type, "paired_accessories");
+                break;
+            case RATGDO_COALESCED_COMMANDS:
+                this->subscribe_sensor(this->coalesced_commands, type, "coalesced_commands");
+                break;
+            case RATGDO_THROTTLED_COMMANDS:
+                this->subscribe_sensor(this->throttled_commands, type, "throttled_commands");
+                break;
+            case RATGDO_FREE_HEAP:
+                this->subscribe_sensor(this->free_heap, type, "free_heap");
+                break;
+            case RATGDO_LARGEST_FREE_BLOCK:
+                this->subscribe_sensor(this->largest_free_block, type, "largest_free_block");
+                break;
+            case RATGDO_HEAP_USED:
+                this->subscribe_sensor(this->heap_used, type, "heap_used");
+                break;
+            case RATGDO_HEAP_USED_PEAK:
+                this->subscribe_sensor(this->heap_used_peak, type, "heap_used_peak");
+                break;
+            case RATGDO_BOOT_SETUP:
+            case RATGDO_BOOT_PROTOCOL_SETUP:
+            case RATGDO_BOOT_FIRST_BYTE:
+            case RATGDO_BOOT_FIRST_FRAME:
+            case RATGDO_BOOT_FIRST_DOOR_STATE:
+            case RATGDO_BOOT_SYNCED:
+            case RATGDO_BOOT_SYNC_FAILED:
+                break; // published by mark_boot_phase
+            case RATGDO_DOOR_OPEN_TIME:
+            case RATGDO_DOOR_OPEN_TIME_24H:
+            case RATGDO_LIGHT_ON_TIME:
+            case RATGDO_LIGHT_ON_TIME_24H:
+            case RATGDO_MOTOR_ON_TIME:
+            case RATGDO_MOTOR_ON_TIME_24H:
+            case RATGDO_OBSTRUCTED_TIME:
+            case RATGDO_OBSTRUCTED_TIME_24H:
+                break; // published by update_state_times
+            default:
+                return;
+            }
+        }
+        this->sensors_[type].add(sensor, publish);
+        if (type >= RATGDO_BOOT_SETUP && type <= RATGDO_BOOT_SYNC_FAILED) {
+            // phases passed before the sensor was set up
+            auto at = this->boot_phases_[type - RATGDO_BOOT_SETUP];
+            if (at != 0) {
+                publish(sensor, at);
+            }
+        } else if (type >= RATGDO_DOOR_OPEN_TIME && type <= RATGDO_OBSTRUCTED_TIME_24H) {
+            const auto& time = this->state_timers_[(type - RATGDO_DOOR_OPEN_TIME) / 2].time;
+            publish(sensor, (type - RATGDO_DOOR_OPEN_TIME) % 2 == 0 ? time.total : time.last_day());
+        }
+    }
+
+    void RATGDOComponent::register_binary_sensor(SensorType type, void* sensor, BinarySensorDispatch::Publish publish)
+    {
+        if (this->binary_sensors_[type].empty()) {
+            switch (type) {
+            case RATGDO_SENSOR_MOTION:
+                this->subscribe_binary_sensor(this->motion_state, type, "motion_state", MotionState::DETECTED);
+                break;
+            case RATGDO_SENSOR_OBSTRUCTION:
+                this->subscribe_binary_sensor(this->obstruction_state, type, "obstruction_state", ObstructionState::OBSTRUCTED);
+                break;
+            case RATGDO_SENSOR_MOTOR:
+                this->subscribe_binary_sensor(this->motor_state, type, "motor_state", MotorState::ON);
+                break;
+            case RATGDO_SENSOR_BUTTON:
+                this->subscribe_binary_sensor(this->button_state, type, "button_state", ButtonState::PRESSED);
+                break;
+            case RATGDO_SENSOR_CONNECTIVITY:
+                this->subscribe_binary_sensor(this->link_state, type, "link_state", LinkState::CONNECTED);
+                break;
+            case RATGDO_SENSOR_DOOR_FAULT:
+                this->subscribe_binary_sensor(this->door_fault, type, "door_fault", true);
+                break;
+            case RATGDO_SENSOR_DOOR_THROTTLED:
+                this->subscribe_binary_sensor(this->door_throttled, type, "door_throttled", true);
+                break;
+            default:
+                return;
+            }
+        }
+        this->binary_sensors_[type].add(sensor, publish);
+    }
+
     // dry contact methods
     void RATGDOComponent::set_dry_contact_open_sensor(esphome::gpio::GPIOBinarySensor* dry_contact_open_sensor)
     {
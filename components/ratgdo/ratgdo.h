@@ -19,10 +19,13 @@
 #include "esphome/components/gpio/binary_sensor/gpio_binary_sensor.h"
 
 #include "callbacks.h"
+#include "entity_dispatch.h"
+#include "event_bus.h"
 #include "macros.h"
 #include "observable.h"
 #include "protocol.h"
 #include "ratgdo_state.h"
+#include "state_time.h"
 
 namespace esphome {
 class InternalGPIOPin;
@@ -35,6 +38,96 @@ namespace ratgdo {
     const float DOOR_DELTA_UNKNOWN = -2.0;
     const uint16_t PAIRED_DEVICES_UNKNOWN = 0xFF;
 
+    enum RATGDOSensorType {
+        RATGDO_OPENINGS,
+        RATGDO_PAIRED_DEVICES_TOTAL,
+        RATGDO_PAIRED_REMOTES,
+        RATGDO_PAIRED_KEYPADS,
+        RATGDO_PAIRED_WALL_CONTROLS,
+        RATGDO_PAIRED_ACCESSORIES,
+        RATGDO_COALESCED_COMMANDS,
+        RATGDO_THROTTLED_COMMANDS,
+        RATGDO_FREE_HEAP,
+        RATGDO_LARGEST_FREE_BLOCK,
+        RATGDO_HEAP_USED,
+        RATGDO_HEAP_USED_PEAK,
+        // boot phase timestamps, in BootPhase order
+        RATGDO_BOOT_SETUP,
+        RATGDO_BOOT_PROTOCOL_SETUP,
+        RATGDO_BOOT_FIRST_BYTE,
+        RATGDO_BOOT_FIRST_FRAME,
+        RATGDO_BOOT_FIRST_DOOR_STATE,
+        RATGDO_BOOT_SYNCED,
+        RATGDO_BOOT_SYNC_FAILED,
+        // seconds in state, total then last 24h, in StateTimeIndex order
+        RATGDO_DOOR_OPEN_TIME,
+        RATGDO_DOOR_OPEN_TIME_24H,
+        RATGDO_LIGHT_ON_TIME,
+        RATGDO_LIGHT_ON_TIME_24H,
+        RATGDO_MOTOR_ON_TIME,
+        RATGDO_MOTOR_ON_TIME_24H,
+        RATGDO_OBSTRUCTED_TIME,
+        RATGDO_OBSTRUCTED_TIME_24H,
+        RATGDO_SENSOR_TYPE_COUNT
+    };
+
+    enum SensorType {
+        RATGDO_SENSOR_MOTION,
+        RATGDO_SENSOR_OBSTRUCTION,
+        RATGDO_SENSOR_MOTOR,
+        RATGDO_SENSOR_BUTTON,
+        RATGDO_SENSOR_CONNECTIVITY,
+        RATGDO_SENSOR_DOOR_FAULT,
+        RATGDO_SENSOR_DOOR_THROTTLED,
+        RATGDO_BINARY_SENSOR_TYPE_COUNT
+    };
+
+    /// Enum for the startup milestones timed at boot.
+    ENUM(BootPhase, uint8_t,
+        (SETUP, 0),
+        (PROTOCOL_SETUP, 1),
+        (FIRST_BYTE, 2),
+        (FIRST_FRAME, 3),
+        (FIRST_DOOR_STATE, 4),
+        (SYNCED, 5),
+        (SYNC_FAILED, 6))
+    const uint8_t BOOT_PHASE_COUNT = 7;
+
+    /// Enum for the protocol engine picked by auto-detection.
+    ENUM(DetectedProtocol, uint8_t,
+        (UNKNOWN, 0),
+        (SECPLUSV2, 1),
+        (SECPLUSV1, 2),
+        (DRYCONTACT, 3))
+
+    /// Enum for the door state the reconciler drives towards.
+    ENUM(DoorTarget, uint8_t,
+        (NONE, 0),
+        (OPEN, 1),
+        (CLOSED, 2),
+        (STOPPED, 3),
+        (POSITION, 4))
+
+    // a desired state and the command currently in flight towards it
+    template <typename T, typename A>
+    struct Target {
+        T value {};
+        bool active { false };
+        uint32_t since { 0 }; // when the target was set
+        uint8_t commands { 0 }; // commands issued for this target
+        A command {};
+        uint32_t command_at { 0 }; // when the command was issued, 0 if none in flight
+    };
+
+    // a door command as requested by an entity, before coalescing
+    struct DoorRequest {
+        DoorAction action;
+        float position { DOOR_POSITION_UNKNOWN }; // set for a move to position
+    };
+
+    typedef EntityDispatch<uint32_t> SensorDispatch;
+    typedef EntityDispatch<bool> BinarySensorDispatch;
+
     struct RATGDOStore {
         int obstruction_low_count = 0; // count obstruction low pulses
 
@@ -44,6 +137,28 @@ namespace ratgdo {
         }
     };
 
+    // state saved on a clean shutdown, restored on the boot that follows it
+    struct RATGDOSnapshot {
+        uint32_t magic;
+        float door_position;
+        uint16_t openings;
+        uint16_t paired_total;
+        uint16_t paired_remotes;
+        uint16_t paired_keypads;
+        uint16_t paired_wall_controls;
+        uint16_t paired_accessories;
+        DoorState door_state;
+        LightState light_state;
+        LockState lock_state;
+    };
+
+    // time-in-state totals, saved every so often. The hourly buckets stay in
+    // RAM, the preference area is small and shared.
+    struct StateTimeSave {
+        uint32_t magic;
+        uint32_t totals[STATE_TIME_COUNT];
+    };
+
     using protocol::Args;
     using protocol::Result;
 
@@ -52,6 +167,7 @@ namespace ratgdo {
         void setup() override;
         void loop() override;
         void dump_config() override;
+        void on_shutdown() override;
 
         void init_protocol();
 
@@ -83,36 +199,44 @@ namespace ratgdo {
         observable<ButtonState> button_state { ButtonState::UNKNOWN };
         observable<MotionState> motion_state { MotionState::UNKNOWN };
         observable<LearnState> learn_state { LearnState::UNKNOWN };
+        observable<LinkState> link_state { LinkState::UNKNOWN };
+        observable<uint32_t> coalesced_commands { 0 };
+        observable<uint32_t> throttled_commands { 0 };
 
-        OnceCallbacks<void(DoorState)> on_door_state_;
+        // memory diagnostics, heap_used counts ratgdo's own containers
+        observable<uint32_t> free_heap { 0 };
+        observable<uint32_t> largest_free_block { 0 };
+        observable<uint32_t> heap_used { 0 };
+        observable<uint32_t> heap_used_peak { 0 };
 
         observable<bool> sync_failed { false };
+        observable<bool> door_fault { false };
+        observable<bool> door_throttled { false };
 
         void set_output_gdo_pin(InternalGPIOPin* pin) { this->output_gdo_pin_ = pin; }
         void set_input_gdo_pin(InternalGPIOPin* pin) { this->input_gdo_pin_ = pin; }
         void set_input_obst_pin(InternalGPIOPin* pin) { this->input_obst_pin_ = pin; }
+        void set_warm_boot(bool warm_boot) { this->warm_boot_ = warm_boot; }
+        void set_coalesce_window(uint32_t window) { this->coalesce_window_ = window; }
+        void set_door_command_burst(uint8_t burst)
+        {
+            this->door_command_burst_ = burst;
+            this->door_tokens_ = burst;
+        }
+        void set_door_command_refill(uint32_t refill) { this->door_command_refill_ = refill; }
 
         // dry contact methods
         void set_dry_contact_open_sensor(esphome::gpio::GPIOBinarySensor* dry_contact_open_sensor_);
         void set_dry_contact_close_sensor(esphome::gpio::GPIOBinarySensor* dry_contact_close_sensor_);
         void set_discrete_open_pin(InternalGPIOPin* pin){ this->protocol_->set_discrete_open_pin(pin); }
         void set_discrete_close_pin(InternalGPIOPin* pin){ this->protocol_->set_discrete_close_pin(pin); }
+        void set_discrete_light_pin(InternalGPIOPin* pin){ this->protocol_->set_discrete_light_pin(pin); }
+        void set_light_auto_off(uint32_t auto_off) { this->light_auto_off_ = auto_off; }
 
         Result call_protocol(Args args);
 
-        void received(const DoorState door_state);
-        void received(const LightState light_state);
-        void received(const LockState lock_state);
-        void received(const ObstructionState obstruction_state);
-        void received(const LightAction light_action);
-        void received(const MotorState motor_state);
-        void received(const ButtonState button_state);
-        void received(const MotionState motion_state);
-        void received(const LearnState light_state);
-        void received(const Openings openings);
-        void received(const TimeToClose ttc);
-        void received(const PairedDeviceCount pdc);
-        void received(const BatteryState pdc);
+        // protocols publish what they hear from the opener here
+        EventBus& events() { return this->events_; }
 
         // door
         void door_toggle();
@@ -120,8 +244,7 @@ namespace ratgdo {
         void door_close();
         void door_stop();
 
-        void door_action(DoorAction action);
-        void ensure_door_action(DoorAction action, uint32_t delay = 1500);
+        bool door_action(DoorAction action);
         void door_move_to_position(float position);
         void set_door_position(float door_position) { this->door_position = door_position; }
         void set_opening_duration(float duration);
@@ -157,32 +280,139 @@ namespace ratgdo {
         void subscribe_rolling_code_counter(std::function<void(uint32_t)>&& f);
         void subscribe_opening_duration(std::function<void(float)>&& f);
         void subscribe_closing_duration(std::function<void(float)>&& f);
-        void subscribe_openings(std::function<void(uint16_t)>&& f);
-        void subscribe_paired_devices_total(std::function<void(uint16_t)>&& f);
-        void subscribe_paired_remotes(std::function<void(uint16_t)>&& f);
-        void subscribe_paired_keypads(std::function<void(uint16_t)>&& f);
-        void subscribe_paired_wall_controls(std::function<void(uint16_t)>&& f);
-        void subscribe_paired_accessories(std::function<void(uint16_t)>&& f);
         void subscribe_door_state(std::function<void(DoorState, float)>&& f);
         void subscribe_light_state(std::function<void(LightState)>&& f);
         void subscribe_lock_state(std::function<void(LockState)>&& f);
-        void subscribe_obstruction_state(std::function<void(ObstructionState)>&& f);
-        void subscribe_motor_state(std::function<void(MotorState)>&& f);
-        void subscribe_button_state(std::function<void(ButtonState)>&& f);
-        void subscribe_motion_state(std::function<void(MotionState)>&& f);
         void subscribe_sync_failed(std::function<void(bool)>&& f);
         void subscribe_learn_state(std::function<void(LearnState)>&& f);
 
+        // sensor entities, one shared subscription per state kind
+        void register_sensor(RATGDOSensorType type, void* sensor, SensorDispatch::Publish publish);
+        void register_binary_sensor(SensorType type, void* sensor, BinarySensorDispatch::Publish publish);
+
+        // boot timing, each phase is recorded once
+        void mark_boot_phase(BootPhase phase);
+        // a protocol saw the first byte on the line
+        void on_traffic();
+
     protected:
+        void received(const DoorState door_state);
+        void received(const LightState light_state);
+        void received(const LockState lock_state);
+        void received(const ObstructionState obstruction_state);
+        void received(const LightAction light_action);
+        void received(const MotorState motor_state);
+        void received(const ButtonState button_state);
+        void received(const MotionState motion_state);
+        void received(const LearnState light_state);
+        void received(const Openings openings);
+        void received(const TimeToClose ttc);
+        void received(const PairedDeviceCount pdc);
+        void received(const BatteryState pdc);
+        void received(const LinkState link_state);
+
+        void subscribe_events();
+        template <typename T>
+        void subscribe_event()
+        {
+            this->events_.subscribe<T>(this, [](void* self, T event) { static_cast<RATGDOComponent*>(self)->received(event); });
+        }
+
+        void schedule_resync();
+        void report_memory(const char* point);
+        void log_boot_phases();
+        void init_state_times();
+        void update_state_times();
+        void save_state_times();
+        void publish_state_time(StateTimeIndex index);
+        void arm_travel_watchdog(DoorState door_state);
+        void check_travel(DoorState door_state, uint8_t queries);
+        void start_protocol_detection();
+        void save_protocol(DetectedProtocol protocol, bool confirmed);
+
+        // door command coalescing
+        void request_door(DoorRequest request);
+        void run_door_request(const DoorRequest& request);
+        void end_coalesce_window();
+        void preempt_door_commands();
+        bool take_door_token(bool may_refuse);
+        void update_motor_running();
+        void refill_door_tokens();
+
+        // desired-state reconciler
+        void set_door_target(DoorTarget target, float position = DOOR_POSITION_UNKNOWN);
+        void set_light_target(LightState target);
+        void set_lock_target(LockState target);
+        void clear_door_target();
+        void reconcile_door();
+        void reconcile_light();
+        void reconcile_lock();
+        void issue_door_command(DoorAction action);
+        void door_target_done(bool reached);
+
+        bool load_snapshot(RATGDOSnapshot& snapshot);
+        void restore_snapshot(const RATGDOSnapshot& snapshot);
+
+        template <typename T>
+        void subscribe_sensor(observable<T>& state, RATGDOSensorType type, const char* name)
+        {
+            state.subscribe([=](T value) {
+                defer(name, [=] { this->sensors_[type](value); });
+            });
+        }
+
+        template <typename T>
+        void subscribe_binary_sensor(observable<T>& state, SensorType type, const char* name, T active)
+        {
+            state.subscribe([=](T value) {
+                defer(name, [=] { this->binary_sensors_[type](value == active); });
+            });
+        }
+
+        SensorDispatch sensors_[RATGDO_SENSOR_TYPE_COUNT];
+        BinarySensorDispatch binary_sensors_[RATGDO_BINARY_SENSOR_TYPE_COUNT];
+
         RATGDOStore isr_store_ {};
         protocol::Protocol* protocol_;
         bool obstruction_from_status_ { false };
-
-        InternalGPIOPin* output_gdo_pin_;
-        InternalGPIOPin* input_gdo_pin_;
-        InternalGPIOPin* input_obst_pin_;
-        esphome::gpio::GPIOBinarySensor* dry_contact_open_sensor_;
-        esphome::gpio::GPIOBinarySensor* dry_contact_close_sensor_;
+        bool warm_boot_ { false };
+        uint32_t coalesce_window_ { 500 };
+        uint32_t light_auto_off_ { 0 };
+        uint8_t door_command_burst_ { 0 };
+        uint32_t door_command_refill_ { 120000 };
+        uint8_t door_tokens_ { 0 };
+        uint32_t door_token_idle_ { 0 };
+        uint32_t door_token_checked_ { 0 };
+        uint32_t door_token_motor_ms_ { 0 }; // motor_on_ms_ at door_token_checked_
+        bool motor_running_ { false };
+        uint32_t motor_on_since_ { 0 };
+        uint32_t motor_on_ms_ { 0 }; // finished runs
+        bool coalescing_ { false };
+        bool door_request_pending_ { false };
+        DoorRequest door_request_ { DoorAction::UNKNOWN };
+        uint32_t resync_delay_ { 0 };
+        Target<DoorTarget, DoorAction> door_target_ {};
+        Target<LightState, LightAction> light_target_ {};
+        Target<LockState, LockAction> lock_target_ {};
+        float door_target_position_ { DOOR_POSITION_UNKNOWN };
+        bool door_position_move_ { false }; // a timed move towards door_target_position_ is under way
+        ESPPreferenceObject snapshot_pref_;
+        DetectedProtocol detected_protocol_ { DetectedProtocol::UNKNOWN };
+        bool protocol_confirmed_ { true };
+        bool sync_on_traffic_ { false }; // detecting, hold off transmitting until the line is busy
+        ESPPreferenceObject protocol_pref_;
+        EventBus events_;
+        StateTimer state_timers_[STATE_TIME_COUNT];
+        uint32_t state_hour_start_ { 0 };
+        bool state_times_dirty_ { false };
+        ESPPreferenceObject state_time_pref_;
+        uint32_t boot_phases_[BOOT_PHASE_COUNT] {};
+
+        InternalGPIOPin* output_gdo_pin_ { nullptr };
+        InternalGPIOPin* input_gdo_pin_ { nullptr };
+        InternalGPIOPin* input_obst_pin_ { nullptr };
+        esphome::gpio::GPIOBinarySensor* dry_contact_open_sensor_ { nullptr };
+        esphome::gpio::GPIOBinarySensor* dry_contact_close_sensor_ { nullptr };
     }; // RATGDOComponent
 
 } // namespace ratgdo
@@ -76,6 +76,13 @@ namespace ratgdo {
         (UNKNOWN, 2))
     LearnState learn_state_toggle(LearnState state);
 
+    /// Enum for the health of the link to the opener.
+    ENUM(LinkState, uint8_t,
+        (DISCONNECTED, 0),
+        (DEGRADED, 1),
+        (CONNECTED, 2),
+        (UNKNOWN, 3))
+
     ENUM(PairedDevice, uint8_t,
         (ALL, 0),
         (REMOTE, 1),
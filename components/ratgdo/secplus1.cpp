@@ -1,5 +1,6 @@
 
 #include "secplus1.h"
+#include "profile.h"
 #include "ratgdo.h"
 
 #include "esphome/core/gpio.h"
@@ -12,6 +13,22 @@ namespace ratgdo {
 
         static const char* const TAG = "ratgdo_secplus1";
 
+        // status traffic flows several times a second from a wall panel or our emulation
+        static const uint32_t LINK_DEGRADED_TIMEOUT = 3000;
+        static const uint32_t LINK_LOST_TIMEOUT = 30000;
+
+        // Light and lock are toggles and a new state only counts after two matching
+        // 0x3A replies, with the door status interleaved that is one every 1.5s.
+        // The lock button is also held for 3.5s. The reconciler must wait all of
+        // that out before toggling again.
+        static const uint32_t COMMAND_TIMEOUT = 8000;
+
+        // emulated wall panel poll period, fast while the door is (about to be) moving
+        static const uint32_t EMULATION_POLL_ACTIVE = 250;
+        static const uint32_t EMULATION_POLL_IDLE = 500;
+        // and after a light or lock toggle, until its two 0x3A replies are in
+        static const uint32_t EMULATION_TOGGLE_WINDOW = 2000;
+
         void Secplus1::setup(RATGDOComponent* ratgdo, Scheduler* scheduler, InternalGPIOPin* rx_pin, InternalGPIOPin* tx_pin)
         {
             this->ratgdo_ = ratgdo;
@@ -22,12 +39,14 @@ namespace ratgdo {
             this->sw_serial_.begin(1200, SWSERIAL_8E1, rx_pin->get_pin(), tx_pin->get_pin(), true);
 
             this->traits_.set_features(HAS_DOOR_STATUS | HAS_LIGHT_TOGGLE | HAS_LOCK_TOGGLE);
+            this->traits_.set_command_timeout(COMMAND_TIMEOUT);
         }
 
         void Secplus1::loop()
         {
             auto rx_cmd = this->read_command();
             if (rx_cmd) {
+                this->ratgdo_->mark_boot_phase(BootPhase::FIRST_FRAME);
                 this->handle_command(rx_cmd.value());
             }
             auto tx_cmd = this->pending_tx();
@@ -38,6 +57,25 @@ namespace ratgdo {
                 !(this->is_0x37_panel_ && tx_cmd.value() == CommandType::TOGGLE_LOCK_PRESS) && this->wall_panel_emulation_state_ != WallPanelEmulationState::RUNNING) {
                 this->do_transmit_if_pending();
             }
+            this->update_link_state();
+        }
+
+        void Secplus1::update_link_state()
+        {
+            if (this->last_status_rx_ == 0) {
+                return;
+            }
+            auto since_status = millis() - this->last_status_rx_;
+            LinkState link_state = LinkState::CONNECTED;
+            if (since_status > LINK_LOST_TIMEOUT) {
+                link_state = LinkState::DISCONNECTED;
+            } else if (since_status > LINK_DEGRADED_TIMEOUT) {
+                link_state = LinkState::DEGRADED;
+            }
+            if (link_state != this->link_state_) {
+                this->link_state_ = link_state;
+                this->ratgdo_->events().publish(link_state);
+            }
         }
 
         void Secplus1::dump_config()
@@ -82,7 +120,18 @@ namespace ratgdo {
             } else if (this->wall_panel_emulation_state_ == WallPanelEmulationState::RUNNING) {
                 // ESP_LOG2(TAG, "[Wall panel emulation] Sending byte: [%02X]", secplus1_states[index]);
 
+                bool active = this->door_activity();
                 if (index < 15 || !this->do_transmit_if_pending()) {
+                    if (index >= 15 && active && this->last_emulated_byte_ != static_cast<uint8_t>(CommandType::QUERY_DOOR_STATUS)) {
+                        // interleave door status queries with the light/lock ones while the door moves
+                        this->last_emulated_byte_ = static_cast<uint8_t>(CommandType::QUERY_DOOR_STATUS);
+                        this->transmit_byte(this->last_emulated_byte_);
+                        this->scheduler_->set_timeout(this->ratgdo_, "wall_panel_emulation", EMULATION_POLL_ACTIVE, [=] {
+                            this->wall_panel_emulation(index);
+                        });
+                        return;
+                    }
+                    this->last_emulated_byte_ = secplus1_states[index];
                     this->transmit_byte(secplus1_states[index]);
                     // gdo response simulation for testing
                     // auto resp = secplus1_states[index] == 0x39 ? 0x00 :
@@ -97,15 +146,30 @@ namespace ratgdo {
                         index = 15;
                     }
                 }
-                this->scheduler_->set_timeout(this->ratgdo_, "wall_panel_emulation", 250, [=] {
+                // the startup sequence keeps the fixed pace of a real panel
+                auto period = index < 15 || active || this->toggle_unconfirmed() ? EMULATION_POLL_ACTIVE : EMULATION_POLL_IDLE;
+                this->scheduler_->set_timeout(this->ratgdo_, "wall_panel_emulation", period, [=] {
                     this->wall_panel_emulation(index);
                 });
             }
         }
 
+        bool Secplus1::door_activity() const
+        {
+            return this->door_moving_ || !this->pending_tx_.empty()
+                || this->door_state == DoorState::OPENING || this->door_state == DoorState::CLOSING
+                || this->maybe_door_state != this->door_state;
+        }
+
+        bool Secplus1::toggle_unconfirmed() const
+        {
+            return millis() - this->last_toggle_tx_ < EMULATION_TOGGLE_WINDOW
+                || this->maybe_light_state != this->light_state || this->maybe_lock_state != this->lock_state;
+        }
+
         void Secplus1::light_action(LightAction action)
         {
-            ESP_LOG1(TAG, "Light action: %s", LightAction_to_string(action));
+            ESP_LOG1(TAG, "Light action: %s", LOG_STR_ARG(LightAction_to_string(action)));
             if (action == LightAction::UNKNOWN) {
                 return;
             }
@@ -117,7 +181,7 @@ namespace ratgdo {
 
         void Secplus1::lock_action(LockAction action)
         {
-            ESP_LOG1(TAG, "Lock action: %s", LockAction_to_string(action));
+            ESP_LOG1(TAG, "Lock action: %s", LOG_STR_ARG(LockAction_to_string(action)));
             if (action == LockAction::UNKNOWN) {
                 return;
             }
@@ -129,7 +193,7 @@ namespace ratgdo {
 
         void Secplus1::door_action(DoorAction action)
         {
-            ESP_LOG1(TAG, "Door action: %s, door state: %s", DoorAction_to_string(action), DoorState_to_string(this->door_state));
+            ESP_LOG1(TAG, "Door action: %s, door state: %s", LOG_STR_ARG(DoorAction_to_string(action)), LOG_STR_ARG(DoorState_to_string(this->door_state)));
             if (action == DoorAction::UNKNOWN) {
                 return;
             }
@@ -205,11 +269,35 @@ namespace ratgdo {
 
         Result Secplus1::call(Args args)
         {
+            if (args.tag == Args::Tag::flush_door_commands) {
+                this->flush_door_commands();
+            }
             return {};
         }
 
-        optional<RxCommand> Secplus1::read_command()
+        void Secplus1::flush_door_commands()
         {
+            // releases still go out, a press that already went out must be let go
+            decltype(this->pending_tx_) kept;
+            uint8_t dropped = 0;
+            while (!this->pending_tx_.empty()) {
+                auto cmd = this->pending_tx_.top();
+                this->pending_tx_.pop();
+                if (cmd.request == CommandType::TOGGLE_DOOR_PRESS) {
+                    dropped++;
+                } else {
+                    kept.push(cmd);
+                }
+            }
+            this->pending_tx_ = std::move(kept);
+            // follow-up toggles of a multi-step open/close/stop
+            this->on_door_state_.clear();
+            ESP_LOGD(TAG, "Flushed %d pending door toggles", dropped);
+        }
+
+        optional<RxCommand> RATGDO_HOT Secplus1::read_command()
+        {
+            RATGDO_PROFILE("secplus1_read_command");
             static bool reading_msg = false;
             static uint32_t msg_start = 0;
             static uint16_t byte_count = 0;
@@ -218,6 +306,10 @@ namespace ratgdo {
             if (!reading_msg) {
                 while (this->sw_serial_.available()) {
                     uint8_t ser_byte = this->sw_serial_.read();
+                    if (this->last_rx_ == 0) {
+                        this->ratgdo_->mark_boot_phase(BootPhase::FIRST_BYTE);
+                        this->ratgdo_->on_traffic();
+                    }
                     this->last_rx_ = millis();
 
                     if (ser_byte < 0x30 || ser_byte > 0x3A) {
@@ -278,8 +370,9 @@ namespace ratgdo {
             ESP_LOG2(TAG, "[%d] Sending packet: [%02X %02X]", millis(), packet[0], packet[1]);
         }
 
-        optional<RxCommand> Secplus1::decode_packet(const RxPacket& packet) const
+        optional<RxCommand> RATGDO_HOT Secplus1::decode_packet(const RxPacket& packet) const
         {
+            RATGDO_PROFILE("secplus1_decode_packet");
             CommandType cmd_type = to_CommandType(packet[0], CommandType::UNKNOWN);
             return RxCommand { cmd_type, packet[1] };
         }
@@ -293,6 +386,10 @@ namespace ratgdo {
 
         void Secplus1::handle_command(const RxCommand& cmd)
         {
+            if (cmd.req == CommandType::QUERY_DOOR_STATUS || cmd.req == CommandType::QUERY_DOOR_STATUS_0x37 || cmd.req == CommandType::QUERY_OTHER_STATUS || cmd.req == CommandType::OBSTRUCTION) {
+                this->last_status_rx_ = millis();
+            }
+
             if (cmd.req == CommandType::QUERY_DOOR_STATUS) {
 
                 DoorState door_state;
@@ -324,14 +421,17 @@ namespace ratgdo {
 
                 if (!this->is_0x37_panel_ && door_state != this->maybe_door_state) {
                     this->maybe_door_state = door_state;
-                    ESP_LOG1(TAG, "Door maybe %s, waiting for 2nd status message to confirm", DoorState_to_string(door_state));
+                    ESP_LOG1(TAG, "Door maybe %s, waiting for 2nd status message to confirm", LOG_STR_ARG(DoorState_to_string(door_state)));
                 } else {
                     this->maybe_door_state = door_state;
                     this->door_state = door_state;
                     if (this->door_state == DoorState::STOPPED || this->door_state == DoorState::OPEN || this->door_state == DoorState::CLOSED) {
                         this->door_moving_ = false;
                     }
-                    this->ratgdo_->received(door_state);
+                    if (door_state != DoorState::UNKNOWN) {
+                        this->ratgdo_->mark_boot_phase(BootPhase::SYNCED);
+                    }
+                    this->ratgdo_->events().publish(door_state);
                 }
             } else if (cmd.req == CommandType::QUERY_DOOR_STATUS_0x37) {
                 this->is_0x37_panel_ = true;
@@ -340,7 +440,7 @@ namespace ratgdo {
                     this->do_transmit_if_pending();
                 } else {
                     // inject door status request
-                    if (door_moving_ || (millis() - this->last_status_query_ > 10000)) {
+                    if (this->door_activity() || (millis() - this->last_status_query_ > 10000)) {
                         this->transmit_byte(static_cast<uint8_t>(CommandType::QUERY_DOOR_STATUS));
                         this->last_status_query_ = millis();
                     }
@@ -352,7 +452,7 @@ namespace ratgdo {
                     this->maybe_light_state = light_state;
                 } else {
                     this->light_state = light_state;
-                    this->ratgdo_->received(light_state);
+                    this->ratgdo_->events().publish(light_state);
                 }
 
                 LockState lock_state = to_LockState((~cmd.resp >> 3) & 1, LockState::UNKNOWN);
@@ -360,11 +460,11 @@ namespace ratgdo {
                     this->maybe_lock_state = lock_state;
                 } else {
                     this->lock_state = lock_state;
-                    this->ratgdo_->received(lock_state);
+                    this->ratgdo_->events().publish(lock_state);
                 }
             } else if (cmd.req == CommandType::OBSTRUCTION) {
                 ObstructionState obstruction_state = cmd.resp == 0 ? ObstructionState::CLEAR : ObstructionState::OBSTRUCTED;
-                this->ratgdo_->received(obstruction_state);
+                this->ratgdo_->events().publish(obstruction_state);
             } else if (cmd.req == CommandType::TOGGLE_DOOR_RELEASE) {
                 if (cmd.resp == 0x31) {
                     this->wall_panel_starting_ = true;
@@ -373,12 +473,12 @@ namespace ratgdo {
                 // motion was detected, or the light toggle button was pressed
                 // either way it's ok to trigger motion detection
                 if (this->light_state == LightState::OFF) {
-                    this->ratgdo_->received(MotionState::DETECTED);
+                    this->ratgdo_->events().publish(MotionState::DETECTED);
                 }
             } else if (cmd.req == CommandType::TOGGLE_DOOR_PRESS) {
-                this->ratgdo_->received(ButtonState::PRESSED);
+                this->ratgdo_->events().publish(ButtonState::PRESSED);
             } else if (cmd.req == CommandType::TOGGLE_DOOR_RELEASE) {
-                this->ratgdo_->received(ButtonState::RELEASED);
+                this->ratgdo_->events().publish(ButtonState::RELEASED);
             }
         }
 
@@ -386,6 +486,11 @@ namespace ratgdo {
         {
             auto cmd = this->pop_pending_tx();
             if (cmd) {
+                auto sent = cmd.value();
+                if (sent == CommandType::TOGGLE_LIGHT_PRESS || sent == CommandType::TOGGLE_LIGHT_RELEASE
+                    || sent == CommandType::TOGGLE_LOCK_PRESS || sent == CommandType::TOGGLE_LOCK_RELEASE) {
+                    this->last_toggle_tx_ = millis();
+                }
                 this->enqueue_command_pair(cmd.value());
                 this->transmit_byte(static_cast<uint32_t>(cmd.value()));
             }
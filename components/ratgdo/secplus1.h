@@ -101,10 +101,14 @@ namespace ratgdo {
             void set_close_limit(bool state){}
             void set_discrete_open_pin(InternalGPIOPin* pin){}
             void set_discrete_close_pin(InternalGPIOPin* pin){}
+            void set_discrete_light_pin(InternalGPIOPin* pin){}
 
 
         protected:
             void wall_panel_emulation(size_t index = 0);
+            bool door_activity() const;
+            bool toggle_unconfirmed() const;
+            void update_link_state();
 
             optional<RxCommand> read_command();
             void handle_command(const RxCommand& cmd);
@@ -123,6 +127,7 @@ namespace ratgdo {
             void toggle_light();
             void toggle_lock();
             void toggle_door();
+            void flush_door_commands();
             void query_status();
 
             LightState light_state { LightState::UNKNOWN };
@@ -142,10 +147,14 @@ namespace ratgdo {
             WallPanelEmulationState wall_panel_emulation_state_ { WallPanelEmulationState::WAITING };
 
             bool is_0x37_panel_ { false };
-            std::priority_queue<TxCommand, std::vector<TxCommand>, FirstToSend> pending_tx_;
+            std::priority_queue<TxCommand, std::vector<TxCommand, CountingAllocator<TxCommand>>, FirstToSend> pending_tx_;
             uint32_t last_rx_ { 0 };
             uint32_t last_tx_ { 0 };
             uint32_t last_status_query_ { 0 };
+            uint32_t last_status_rx_ { 0 };
+            LinkState link_state_ { LinkState::UNKNOWN }; // last published
+            uint8_t last_emulated_byte_ { 0 };
+            uint32_t last_toggle_tx_ { 0 };
 
             Traits traits_;
 
@@ -1,5 +1,6 @@
 
 #include "secplus2.h"
+#include "profile.h"
 #include "ratgdo.h"
 
 #include "esphome/core/gpio.h"
@@ -24,8 +25,31 @@ namespace ratgdo {
         // expects.
         static const uint8_t MAX_CODES_WITHOUT_FLASH_WRITE = 60;
 
+        // Background traffic (keepalives, ping replies, status polls) would commit
+        // the counter to flash every minute for the life of the device. It only
+        // publishes the counter every MAX_UNSAVED_CODES codes, well inside what
+        // the MAX_CODES_WITHOUT_FLASH_WRITE bump recovers after a reboot.
+        static const uint8_t MAX_UNSAVED_CODES = 20;
+
         static const char* const TAG = "ratgdo_secplus2";
 
+        // the opener answers every command we send, if it doesn't the link is degraded
+        static const uint32_t LINK_RESPONSE_TIMEOUT = 3000;
+        static const uint32_t LINK_LOST_TIMEOUT = 30000;
+
+        // once the bit timing is known auto-baud only costs ISR time, lock it after a
+        // run of good frames and go back to measuring after a run of bad ones
+        static const uint8_t AUTOBAUD_LOCK_FRAMES = 3;
+        static const uint8_t AUTOBAUD_UNLOCK_FAILURES = 3;
+
+        // status is polled quickly while the door moves or a command is unconfirmed,
+        // otherwise only as a keepalive. any status from the opener restarts the wait
+        static const uint32_t STATUS_POLL_ACTIVE = 1000;
+        static const uint32_t STATUS_POLL_IDLE = 300000;
+
+        // an emulated wall control pings the opener when it has been quiet this long
+        static const uint32_t WALL_CONTROL_PING_INTERVAL = 30000;
+
         void Secplus2::setup(RATGDOComponent* ratgdo, Scheduler* scheduler, InternalGPIOPin* rx_pin, InternalGPIOPin* tx_pin)
         {
             this->ratgdo_ = ratgdo;
@@ -33,8 +57,13 @@ namespace ratgdo {
             this->tx_pin_ = tx_pin;
             this->rx_pin_ = rx_pin;
 
+#ifdef SECPLUSV2_LISTEN_ONLY
+            // receive only, the tx pin is never driven
+            this->sw_serial_.begin(9600, SWSERIAL_8N1, rx_pin->get_pin(), -1, true);
+#else
             this->sw_serial_.begin(9600, SWSERIAL_8N1, rx_pin->get_pin(), tx_pin->get_pin(), true);
             this->sw_serial_.enableIntTx(false);
+#endif
             this->sw_serial_.enableAutoBaud(true);
 
             this->traits_.set_features(Traits::all());
@@ -42,6 +71,18 @@ namespace ratgdo {
 
         void Secplus2::loop()
         {
+            this->update_link_state();
+
+#ifdef SECPLUSV2_LISTEN_ONLY
+            auto cmd = this->read_command();
+            if (cmd) {
+                if (this->last_rx_ == 0) {
+                    this->ratgdo_->mark_boot_phase(BootPhase::FIRST_FRAME);
+                }
+                this->last_rx_ = millis();
+                this->handle_command(*cmd);
+            }
+#else
             if (this->transmit_pending_) {
                 if (!this->transmit_packet()) {
                     return;
@@ -50,7 +91,78 @@ namespace ratgdo {
 
             auto cmd = this->read_command();
             if (cmd) {
+                if (this->last_rx_ == 0) {
+                    this->ratgdo_->mark_boot_phase(BootPhase::FIRST_FRAME);
+                }
+                this->last_rx_ = millis();
+                this->awaiting_response_since_ = 0;
                 this->handle_command(*cmd);
+            } else {
+#ifdef SECPLUSV2_WALL_CONTROL_EMULATION
+                this->wall_control_keepalive();
+#endif
+                this->poll_status();
+            }
+#endif
+        }
+
+        void Secplus2::wall_control_keepalive()
+        {
+            if (this->transmit_pending_ || *this->ratgdo_->link_state != LinkState::CONNECTED) {
+                return;
+            }
+            auto now = millis();
+            if (now - this->last_ping_ < WALL_CONTROL_PING_INTERVAL) {
+                return;
+            }
+            ESP_LOG2(TAG, "Wall control keepalive ping");
+            this->last_ping_ = now;
+            this->send_command(CommandType::PING, IncrementRollingCode::BATCHED);
+        }
+
+        void Secplus2::poll_status()
+        {
+            auto door_state = *this->ratgdo_->door_state;
+            if (this->transmit_pending_ || door_state == DoorState::UNKNOWN) {
+                return; // sync takes care of the first status
+            }
+            if (*this->ratgdo_->link_state != LinkState::CONNECTED) {
+                return; // the component probes an unhealthy link with its own backoff
+            }
+            bool active = door_state == DoorState::OPENING || door_state == DoorState::CLOSING || this->awaiting_response_since_ != 0;
+            auto interval = active ? STATUS_POLL_ACTIVE : STATUS_POLL_IDLE;
+            auto now = millis();
+            if (now - this->last_status_ < interval) {
+                return;
+            }
+            ESP_LOG2(TAG, "Polling status (%s)", active ? "active" : "keepalive");
+            this->last_status_ = now;
+            this->send_command(CommandType::GET_STATUS, IncrementRollingCode::BATCHED);
+        }
+
+        void Secplus2::update_link_state()
+        {
+            LinkState link_state;
+            if (this->transmit_pending_ && this->transmit_pending_start_ == 0) {
+                // line held for too long, nothing can be sent
+                link_state = LinkState::DISCONNECTED;
+            } else if (this->awaiting_response_since_ != 0) {
+                auto waiting = millis() - this->awaiting_response_since_;
+                if (waiting > LINK_LOST_TIMEOUT) {
+                    link_state = LinkState::DISCONNECTED;
+                } else if (waiting > LINK_RESPONSE_TIMEOUT) {
+                    link_state = LinkState::DEGRADED;
+                } else {
+                    return;
+                }
+            } else if (this->last_rx_ != 0) {
+                link_state = LinkState::CONNECTED;
+            } else {
+                return;
+            }
+            if (link_state != this->link_state_) {
+                this->link_state_ = link_state;
+                this->ratgdo_->events().publish(link_state);
             }
         }
 
@@ -58,7 +170,18 @@ namespace ratgdo {
         {
             ESP_LOGCONFIG(TAG, "  Rolling Code Counter: %d", *this->rolling_code_counter_);
             ESP_LOGCONFIG(TAG, "  Client ID: %d", this->client_id_);
+            if (this->autobaud_locked_) {
+                ESP_LOGCONFIG(TAG, "  Baud rate: %d (locked)", this->sw_serial_.baudRate());
+            } else {
+                ESP_LOGCONFIG(TAG, "  Baud rate: auto");
+            }
             ESP_LOGCONFIG(TAG, "  Protocol: SEC+ v2");
+#ifdef SECPLUSV2_LISTEN_ONLY
+            ESP_LOGCONFIG(TAG, "  Mode: listen only");
+#endif
+#ifdef SECPLUSV2_WALL_CONTROL_EMULATION
+            ESP_LOGCONFIG(TAG, "  Mode: wall control emulation");
+#endif
         }
 
         void Secplus2::sync_helper(uint32_t start, uint32_t delay, uint8_t tries)
@@ -94,6 +217,7 @@ namespace ratgdo {
             }
 
             if (synced) {
+                this->ratgdo_->mark_boot_phase(BootPhase::SYNCED);
                 return;
             }
 
@@ -118,8 +242,13 @@ namespace ratgdo {
 
         void Secplus2::sync()
         {
+#ifdef SECPLUSV2_LISTEN_ONLY
+            // state arrives with unsolicited status and other devices' queries
+            ESP_LOGD(TAG, "Listen only, waiting for traffic from the opener");
+#else
             this->scheduler_->cancel_timeout(this->ratgdo_, "sync");
             this->sync_helper(millis(), 500, 0);
+#endif
         }
 
         void Secplus2::light_action(LightAction action)
@@ -169,6 +298,8 @@ namespace ratgdo {
                 this->activate_learn();
             } else if (args.tag == Tag::inactivate_learn) {
                 this->inactivate_learn();
+            } else if (args.tag == Tag::flush_door_commands) {
+                this->flush_door_commands();
             }
             return {};
         }
@@ -182,6 +313,20 @@ namespace ratgdo {
             });
         }
 
+        // Only an unsent press can be dropped, once it is out the scheduled
+        // release has to follow it.
+        void Secplus2::flush_door_commands()
+        {
+            if (!this->transmit_pending_ || !this->tx_door_press_) {
+                return;
+            }
+            ESP_LOGD(TAG, "Dropping unsent door press");
+            this->transmit_pending_ = false;
+            this->transmit_pending_start_ = 0;
+            this->tx_door_press_ = false;
+            this->on_command_sent_.clear();
+        }
+
         void Secplus2::query_status()
         {
             this->send_command(CommandType::GET_STATUS);
@@ -210,7 +355,7 @@ namespace ratgdo {
 
         void Secplus2::query_paired_devices(PairedDevice kind)
         {
-            ESP_LOGD(TAG, "Query paired devices of type: %s", PairedDevice_to_string(kind));
+            ESP_LOGD(TAG, "Query paired devices of type: %s", LOG_STR_ARG(PairedDevice_to_string(kind)));
             this->send_command(Command { CommandType::GET_PAIRED_DEVICES, static_cast<uint8_t>(kind) });
         }
 
@@ -220,7 +365,7 @@ namespace ratgdo {
             if (kind == PairedDevice::UNKNOWN) {
                 return;
             }
-            ESP_LOGW(TAG, "Clear paired devices of type: %s", PairedDevice_to_string(kind));
+            ESP_LOGW(TAG, "Clear paired devices of type: %s", LOG_STR_ARG(PairedDevice_to_string(kind)));
             if (kind == PairedDevice::ALL) {
                 this->scheduler_->set_timeout(this->ratgdo_, "", 200, [=] { this->send_command(Command { CommandType::CLEAR_PAIRED_DEVICES, static_cast<uint8_t>(PairedDevice::REMOTE) - 1 }); }); // wireless
                 this->scheduler_->set_timeout(this->ratgdo_, "", 400, [=] { this->send_command(Command { CommandType::CLEAR_PAIRED_DEVICES, static_cast<uint8_t>(PairedDevice::KEYPAD) - 1 }); }); // keypads
@@ -253,8 +398,9 @@ namespace ratgdo {
             this->scheduler_->set_timeout(this->ratgdo_, "", 500, [=] { this->query_status(); });
         }
 
-        optional<Command> Secplus2::read_command()
+        optional<Command> RATGDO_HOT Secplus2::read_command()
         {
+            RATGDO_PROFILE("secplus2_read_command");
             static bool reading_msg = false;
             static uint32_t msg_start = 0;
             static uint16_t byte_count = 0;
@@ -264,6 +410,10 @@ namespace ratgdo {
             if (!reading_msg) {
                 while (this->sw_serial_.available()) {
                     uint8_t ser_byte = this->sw_serial_.read();
+                    if (last_read == 0) {
+                        this->ratgdo_->mark_boot_phase(BootPhase::FIRST_BYTE);
+                        this->ratgdo_->on_traffic();
+                    }
                     last_read = millis();
 
                     if (ser_byte != 0x55 && ser_byte != 0x01 && ser_byte != 0x00) {
@@ -309,6 +459,7 @@ namespace ratgdo {
                     ESP_LOGW(TAG, "Discard incomplete packet, length: %d", byte_count);
                     reading_msg = false;
                     byte_count = 0;
+                    this->track_frame(false);
                 }
             }
 
@@ -340,13 +491,39 @@ namespace ratgdo {
                 packet[18]);
         }
 
-        optional<Command> Secplus2::decode_packet(const WirePacket& packet) const
+        void Secplus2::track_frame(bool valid)
+        {
+            if (valid) {
+                this->framing_failures_ = 0;
+                if (!this->autobaud_locked_ && ++this->valid_frames_ >= AUTOBAUD_LOCK_FRAMES) {
+                    this->sw_serial_.enableAutoBaud(false);
+                    this->autobaud_locked_ = true;
+                    ESP_LOGD(TAG, "Locked baud rate at %d after %d valid frames", this->sw_serial_.baudRate(), this->valid_frames_);
+                }
+            } else {
+                this->valid_frames_ = 0;
+                if (this->autobaud_locked_ && ++this->framing_failures_ >= AUTOBAUD_UNLOCK_FAILURES) {
+                    this->sw_serial_.enableAutoBaud(true);
+                    this->autobaud_locked_ = false;
+                    this->framing_failures_ = 0;
+                    ESP_LOGW(TAG, "Repeated framing failures, re-enabling auto-baud");
+                }
+            }
+        }
+
+        optional<Command> RATGDO_HOT Secplus2::decode_packet(const WirePacket& packet)
         {
+            RATGDO_PROFILE("secplus2_decode_packet");
             uint32_t rolling = 0;
             uint64_t fixed = 0;
             uint32_t data = 0;
 
-            decode_wireline(packet, &rolling, &fixed, &data);
+            if (decode_wireline(packet, &rolling, &fixed, &data) < 0) {
+                ESP_LOGW(TAG, "Failed to decode packet");
+                this->track_frame(false);
+                return {};
+            }
+            this->track_frame(true);
 
             uint16_t cmd = ((fixed >> 24) & 0xf00) | (data & 0xff);
             data &= ~0xf000; // clear parity nibble
@@ -363,36 +540,37 @@ namespace ratgdo {
             uint8_t byte1 = (data >> 16) & 0xff;
             uint8_t byte2 = (data >> 24) & 0xff;
 
-            ESP_LOG1(TAG, "cmd=%03x (%s) byte2=%02x byte1=%02x nibble=%01x", cmd, CommandType_to_string(cmd_type), byte2, byte1, nibble);
+            ESP_LOG1(TAG, "cmd=%03x (%s) byte2=%02x byte1=%02x nibble=%01x", cmd, LOG_STR_ARG(CommandType_to_string(cmd_type)), byte2, byte1, nibble);
 
             return Command { cmd_type, nibble, byte1, byte2 };
         }
 
         void Secplus2::handle_command(const Command& cmd)
         {
-            ESP_LOG1(TAG, "Handle command: %s", CommandType_to_string(cmd.type));
+            ESP_LOG1(TAG, "Handle command: %s", LOG_STR_ARG(CommandType_to_string(cmd.type)));
 
             if (cmd.type == CommandType::STATUS) {
+                this->last_status_ = millis();
 
-                this->ratgdo_->received(to_DoorState(cmd.nibble, DoorState::UNKNOWN));
-                this->ratgdo_->received(to_LightState((cmd.byte2 >> 1) & 1, LightState::UNKNOWN));
-                this->ratgdo_->received(to_LockState((cmd.byte2 & 1), LockState::UNKNOWN));
+                this->ratgdo_->events().publish(to_DoorState(cmd.nibble, DoorState::UNKNOWN));
+                this->ratgdo_->events().publish(to_LightState((cmd.byte2 >> 1) & 1, LightState::UNKNOWN));
+                this->ratgdo_->events().publish(to_LockState((cmd.byte2 & 1), LockState::UNKNOWN));
                 // ESP_LOGD(TAG, "Obstruction: reading from byte2, bit2, status=%d", ((byte2 >> 2) & 1) == 1);
-                this->ratgdo_->received(to_ObstructionState((cmd.byte1 >> 6) & 1, ObstructionState::UNKNOWN));
-                this->ratgdo_->received(to_LearnState((cmd.byte2 >> 5) & 1, LearnState::UNKNOWN));
+                this->ratgdo_->events().publish(to_ObstructionState((cmd.byte1 >> 6) & 1, ObstructionState::UNKNOWN));
+                this->ratgdo_->events().publish(to_LearnState((cmd.byte2 >> 5) & 1, LearnState::UNKNOWN));
             } else if (cmd.type == CommandType::LIGHT) {
-                this->ratgdo_->received(to_LightAction(cmd.nibble, LightAction::UNKNOWN));
+                this->ratgdo_->events().publish(to_LightAction(cmd.nibble, LightAction::UNKNOWN));
             } else if (cmd.type == CommandType::MOTOR_ON) {
-                this->ratgdo_->received(MotorState::ON);
+                this->ratgdo_->events().publish(MotorState::ON);
             } else if (cmd.type == CommandType::DOOR_ACTION) {
                 auto button_state = (cmd.byte1 & 1) == 1 ? ButtonState::PRESSED : ButtonState::RELEASED;
-                this->ratgdo_->received(button_state);
+                this->ratgdo_->events().publish(button_state);
             } else if (cmd.type == CommandType::MOTION) {
-                this->ratgdo_->received(MotionState::DETECTED);
+                this->ratgdo_->events().publish(MotionState::DETECTED);
             } else if (cmd.type == CommandType::OPENINGS) {
-                this->ratgdo_->received(Openings { static_cast<uint16_t>((cmd.byte1 << 8) | cmd.byte2), cmd.nibble });
+                this->ratgdo_->events().publish(Openings { static_cast<uint16_t>((cmd.byte1 << 8) | cmd.byte2), cmd.nibble });
             } else if (cmd.type == CommandType::SET_TTC) {
-                this->ratgdo_->received(TimeToClose { static_cast<uint16_t>((cmd.byte1 << 8) | cmd.byte2) });
+                this->ratgdo_->events().publish(TimeToClose { static_cast<uint16_t>((cmd.byte1 << 8) | cmd.byte2) });
             } else if (cmd.type == CommandType::PAIRED_DEVICES) {
                 PairedDeviceCount pdc;
                 pdc.kind = to_PairedDevice(cmd.nibble, PairedDevice::UNKNOWN);
@@ -407,37 +585,59 @@ namespace ratgdo {
                 } else if (pdc.kind == PairedDevice::ACCESSORY) {
                     pdc.count = cmd.byte2;
                 }
-                this->ratgdo_->received(pdc);
+                this->ratgdo_->events().publish(pdc);
             } else if (cmd.type == CommandType::BATTERY_STATUS) {
-                this->ratgdo_->received(to_BatteryState(cmd.byte1, BatteryState::UNKNOWN));
+                this->ratgdo_->events().publish(to_BatteryState(cmd.byte1, BatteryState::UNKNOWN));
+#ifdef SECPLUSV2_WALL_CONTROL_EMULATION
+            } else if (cmd.type == CommandType::PING) {
+                // answer like a wall control would, keeps the opener pushing status.
+                // One exchange per keepalive interval is enough, each reply costs a code
+                if (millis() - this->last_ping_ >= WALL_CONTROL_PING_INTERVAL) {
+                    this->last_ping_ = millis();
+                    this->send_command(CommandType::PING_RESP, IncrementRollingCode::BATCHED);
+                }
+            } else if (cmd.type == CommandType::PING_RESP) {
+                this->last_ping_ = millis();
+#endif
             }
 
-            ESP_LOG1(TAG, "Done handle command: %s", CommandType_to_string(cmd.type));
+            ESP_LOG1(TAG, "Done handle command: %s", LOG_STR_ARG(CommandType_to_string(cmd.type)));
         }
 
         void Secplus2::send_command(Command command, IncrementRollingCode increment)
         {
-            ESP_LOG1(TAG, "Send command: %s, data: %02X%02X%02X", CommandType_to_string(command.type), command.byte2, command.byte1, command.nibble);
+            ESP_LOG1(TAG, "Send command: %s, data: %02X%02X%02X", LOG_STR_ARG(CommandType_to_string(command.type)), command.byte2, command.byte1, command.nibble);
+#ifdef SECPLUSV2_LISTEN_ONLY
+            ESP_LOGD(TAG, "Listen only, not sending command: %s", LOG_STR_ARG(CommandType_to_string(command.type)));
+#else
             if (!this->transmit_pending_) { // have an untransmitted packet
                 this->encode_packet(command, this->tx_packet_);
+                this->tx_door_press_ = command.type == CommandType::DOOR_ACTION && command.byte1 == 1;
+                // pings go both ways as keepalives, nothing is owed for them
+                this->tx_expects_reply_ = command.type != CommandType::PING && command.type != CommandType::PING_RESP;
                 if (increment == IncrementRollingCode::YES) {
                     this->increment_rolling_code_counter();
+                } else if (increment == IncrementRollingCode::BATCHED && ++this->unsaved_codes_ == MAX_UNSAVED_CODES) {
+                    this->increment_rolling_code_counter(0);
                 }
             } else {
                 // unlikely this would happed (unless not connected to GDO), we're ensuring any pending packet
                 // is transmitted each loop before doing anyting else
                 if (this->transmit_pending_start_ > 0) {
-                    ESP_LOGW(TAG, "Have untransmitted packet, ignoring command: %s", CommandType_to_string(command.type));
+                    ESP_LOGW(TAG, "Have untransmitted packet, ignoring command: %s", LOG_STR_ARG(CommandType_to_string(command.type)));
                 } else {
-                    ESP_LOGW(TAG, "Not connected to GDO, ignoring command: %s", CommandType_to_string(command.type));
+                    ESP_LOGW(TAG, "Not connected to GDO, ignoring command: %s", LOG_STR_ARG(CommandType_to_string(command.type)));
                 }
             }
             this->transmit_packet();
+#endif
         }
 
         void Secplus2::send_command(Command command, IncrementRollingCode increment, std::function<void()>&& on_sent)
         {
+#ifndef SECPLUSV2_LISTEN_ONLY
             this->on_command_sent_(on_sent);
+#endif
             this->send_command(command, increment);
         }
 
@@ -447,8 +647,10 @@ namespace ratgdo {
             uint64_t fixed = ((cmd & ~0xff) << 24) | this->client_id_;
             uint32_t data = (static_cast<uint64_t>(command.byte2) << 24) | (static_cast<uint64_t>(command.byte1) << 16) | (static_cast<uint64_t>(command.nibble) << 8) | (cmd & 0xff);
 
-            ESP_LOG2(TAG, "[%ld] Encode for transmit rolling=%07" PRIx32 " fixed=%010" PRIx64 " data=%08" PRIx32, millis(), *this->rolling_code_counter_, fixed, data);
-            encode_wireline(*this->rolling_code_counter_, fixed, data, packet);
+            uint32_t rolling = (*this->rolling_code_counter_ + this->unsaved_codes_) & 0xfffffff;
+
+            ESP_LOG2(TAG, "[%ld] Encode for transmit rolling=%07" PRIx32 " fixed=%010" PRIx64 " data=%08" PRIx32, millis(), rolling, fixed, data);
+            encode_wireline(rolling, fixed, data, packet);
         }
 
         bool Secplus2::transmit_packet()
@@ -487,18 +689,24 @@ namespace ratgdo {
 
             this->transmit_pending_ = false;
             this->transmit_pending_start_ = 0;
+            if (this->tx_expects_reply_ && this->awaiting_response_since_ == 0) {
+                this->awaiting_response_since_ = millis();
+            }
             this->on_command_sent_.trigger();
             return true;
         }
 
         void Secplus2::increment_rolling_code_counter(int delta)
         {
-            this->rolling_code_counter_ = (*this->rolling_code_counter_ + delta) & 0xfffffff;
+            // codes used in the background are published with the next step
+            this->rolling_code_counter_ = (*this->rolling_code_counter_ + this->unsaved_codes_ + delta) & 0xfffffff;
+            this->unsaved_codes_ = 0;
         }
 
         void Secplus2::set_rolling_code_counter(uint32_t counter)
         {
             ESP_LOGV(TAG, "Set rolling code counter to %d", counter);
+            this->unsaved_codes_ = 0;
             this->rolling_code_counter_ = counter;
         }
 
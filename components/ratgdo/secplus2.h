@@ -64,6 +64,7 @@ namespace ratgdo {
         enum class IncrementRollingCode {
             NO,
             YES,
+            BATCHED, // increment, publish (and save) only every MAX_UNSAVED_CODES
         };
 
         struct Command {
@@ -106,6 +107,7 @@ namespace ratgdo {
             void set_close_limit(bool state){}
             void set_discrete_open_pin(InternalGPIOPin* pin){}
             void set_discrete_close_pin(InternalGPIOPin* pin){}
+            void set_discrete_light_pin(InternalGPIOPin* pin){}
 
         protected:
             void increment_rolling_code_counter(int delta = 1);
@@ -121,6 +123,7 @@ namespace ratgdo {
             bool transmit_packet();
 
             void door_command(DoorAction action);
+            void flush_door_commands();
 
             void query_status();
             void query_openings();
@@ -131,17 +134,33 @@ namespace ratgdo {
             void inactivate_learn();
 
             void print_packet(const char* prefix, const WirePacket& packet) const;
-            optional<Command> decode_packet(const WirePacket& packet) const;
+            optional<Command> decode_packet(const WirePacket& packet);
+            void track_frame(bool valid);
 
             void sync_helper(uint32_t start, uint32_t delay, uint8_t tries);
+            void update_link_state();
+            void poll_status();
+            void wall_control_keepalive();
 
             LearnState learn_state_ { LearnState::UNKNOWN };
 
             observable<uint32_t> rolling_code_counter_ { 0 };
+            uint8_t unsaved_codes_ { 0 }; // used past rolling_code_counter_, not yet published
             uint64_t client_id_ { 0x539 };
 
             bool transmit_pending_ { false };
             uint32_t transmit_pending_start_ { 0 };
+            bool tx_door_press_ { false }; // tx_packet_ holds a door button press
+            bool tx_expects_reply_ { true }; // the opener answers what tx_packet_ holds
+            uint32_t last_rx_ { 0 };
+            uint32_t last_status_ { 0 }; // last status received or polled
+            uint32_t last_ping_ { 0 }; // last ping exchanged with the opener
+
+            bool autobaud_locked_ { false };
+            uint8_t valid_frames_ { 0 };
+            uint8_t framing_failures_ { 0 };
+            uint32_t awaiting_response_since_ { 0 };
+            LinkState link_state_ { LinkState::UNKNOWN }; // last published
             WirePacket tx_packet_;
             OnceCallbacks<void()> on_command_sent_;
 
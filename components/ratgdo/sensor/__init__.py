@@ -18,6 +18,27 @@ TYPES = {
     "paired_devices_keypads": RATGDOSensorType.RATGDO_PAIRED_KEYPADS,
     "paired_devices_wall_controls": RATGDOSensorType.RATGDO_PAIRED_WALL_CONTROLS,
     "paired_devices_accessories": RATGDOSensorType.RATGDO_PAIRED_ACCESSORIES,
+    "coalesced_commands": RATGDOSensorType.RATGDO_COALESCED_COMMANDS,
+    "throttled_commands": RATGDOSensorType.RATGDO_THROTTLED_COMMANDS,
+    "free_heap": RATGDOSensorType.RATGDO_FREE_HEAP,
+    "largest_free_block": RATGDOSensorType.RATGDO_LARGEST_FREE_BLOCK,
+    "heap_used": RATGDOSensorType.RATGDO_HEAP_USED,
+    "heap_used_peak": RATGDOSensorType.RATGDO_HEAP_USED_PEAK,
+    "boot_setup": RATGDOSensorType.RATGDO_BOOT_SETUP,
+    "boot_protocol_setup": RATGDOSensorType.RATGDO_BOOT_PROTOCOL_SETUP,
+    "boot_first_byte": RATGDOSensorType.RATGDO_BOOT_FIRST_BYTE,
+    "boot_first_frame": RATGDOSensorType.RATGDO_BOOT_FIRST_FRAME,
+    "boot_first_door_state": RATGDOSensorType.RATGDO_BOOT_FIRST_DOOR_STATE,
+    "boot_synced": RATGDOSensorType.RATGDO_BOOT_SYNCED,
+    "boot_sync_failed": RATGDOSensorType.RATGDO_BOOT_SYNC_FAILED,
+    "door_open_time": RATGDOSensorType.RATGDO_DOOR_OPEN_TIME,
+    "door_open_time_24h": RATGDOSensorType.RATGDO_DOOR_OPEN_TIME_24H,
+    "light_on_time": RATGDOSensorType.RATGDO_LIGHT_ON_TIME,
+    "light_on_time_24h": RATGDOSensorType.RATGDO_LIGHT_ON_TIME_24H,
+    "motor_on_time": RATGDOSensorType.RATGDO_MOTOR_ON_TIME,
+    "motor_on_time_24h": RATGDOSensorType.RATGDO_MOTOR_ON_TIME_24H,
+    "obstructed_time": RATGDOSensorType.RATGDO_OBSTRUCTED_TIME,
+    "obstructed_time_24h": RATGDOSensorType.RATGDO_OBSTRUCTED_TIME_24H,
 }
 
 
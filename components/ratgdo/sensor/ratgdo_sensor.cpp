@@ -9,31 +9,9 @@ namespace ratgdo {
 
     void RATGDOSensor::setup()
     {
-        if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_OPENINGS) {
-            this->parent_->subscribe_openings([=](uint16_t value) {
-                this->publish_state(value);
-            });
-        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_PAIRED_DEVICES_TOTAL) {
-            this->parent_->subscribe_paired_devices_total([=](uint16_t value) {
-                this->publish_state(value);
-            });
-        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_PAIRED_REMOTES) {
-            this->parent_->subscribe_paired_remotes([=](uint16_t value) {
-                this->publish_state(value);
-            });
-        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_PAIRED_KEYPADS) {
-            this->parent_->subscribe_paired_keypads([=](uint16_t value) {
-                this->publish_state(value);
-            });
-        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_PAIRED_WALL_CONTROLS) {
-            this->parent_->subscribe_paired_wall_controls([=](uint16_t value) {
-                this->publish_state(value);
-            });
-        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_PAIRED_ACCESSORIES) {
-            this->parent_->subscribe_paired_accessories([=](uint16_t value) {
-                this->publish_state(value);
-            });
-        }
+        this->parent_->register_sensor(this->ratgdo_sensor_type_, this, [](void* sensor, uint32_t value) {
+            static_cast<RATGDOSensor*>(sensor)->publish_state(value);
+        });
     }
 
     void RATGDOSensor::dump_config()
@@ -51,6 +29,48 @@ namespace ratgdo {
             ESP_LOGCONFIG(TAG, "  Type: Paired Wall Controls");
         } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_PAIRED_ACCESSORIES) {
             ESP_LOGCONFIG(TAG, "  Type: Paired Accessories");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_COALESCED_COMMANDS) {
+            ESP_LOGCONFIG(TAG, "  Type: Coalesced Commands");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_THROTTLED_COMMANDS) {
+            ESP_LOGCONFIG(TAG, "  Type: Throttled Commands");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_FREE_HEAP) {
+            ESP_LOGCONFIG(TAG, "  Type: Free Heap");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_LARGEST_FREE_BLOCK) {
+            ESP_LOGCONFIG(TAG, "  Type: Largest Free Block");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_HEAP_USED) {
+            ESP_LOGCONFIG(TAG, "  Type: Heap Used");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_HEAP_USED_PEAK) {
+            ESP_LOGCONFIG(TAG, "  Type: Heap Used Peak");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_BOOT_SETUP) {
+            ESP_LOGCONFIG(TAG, "  Type: Boot Setup");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_BOOT_PROTOCOL_SETUP) {
+            ESP_LOGCONFIG(TAG, "  Type: Boot Protocol Setup");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_BOOT_FIRST_BYTE) {
+            ESP_LOGCONFIG(TAG, "  Type: Boot First Byte");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_BOOT_FIRST_FRAME) {
+            ESP_LOGCONFIG(TAG, "  Type: Boot First Frame");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_BOOT_FIRST_DOOR_STATE) {
+            ESP_LOGCONFIG(TAG, "  Type: Boot First Door State");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_BOOT_SYNCED) {
+            ESP_LOGCONFIG(TAG, "  Type: Boot Synced");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_BOOT_SYNC_FAILED) {
+            ESP_LOGCONFIG(TAG, "  Type: Boot Sync Failed");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_DOOR_OPEN_TIME) {
+            ESP_LOGCONFIG(TAG, "  Type: Door Open Time");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_DOOR_OPEN_TIME_24H) {
+            ESP_LOGCONFIG(TAG, "  Type: Door Open Time 24h");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_LIGHT_ON_TIME) {
+            ESP_LOGCONFIG(TAG, "  Type: Light On Time");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_LIGHT_ON_TIME_24H) {
+            ESP_LOGCONFIG(TAG, "  Type: Light On Time 24h");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_MOTOR_ON_TIME) {
+            ESP_LOGCONFIG(TAG, "  Type: Motor On Time");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_MOTOR_ON_TIME_24H) {
+            ESP_LOGCONFIG(TAG, "  Type: Motor On Time 24h");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_OBSTRUCTED_TIME) {
+            ESP_LOGCONFIG(TAG, "  Type: Obstructed Time");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_OBSTRUCTED_TIME_24H) {
+            ESP_LOGCONFIG(TAG, "  Type: Obstructed Time 24h");
         }
     }
 
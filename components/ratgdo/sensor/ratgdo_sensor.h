@@ -8,15 +8,6 @@
 namespace esphome {
 namespace ratgdo {
 
-    enum RATGDOSensorType {
-        RATGDO_OPENINGS,
-        RATGDO_PAIRED_DEVICES_TOTAL,
-        RATGDO_PAIRED_REMOTES,
-        RATGDO_PAIRED_KEYPADS,
-        RATGDO_PAIRED_WALL_CONTROLS,
-        RATGDO_PAIRED_ACCESSORIES
-    };
-
     class RATGDOSensor : public sensor::Sensor, public RATGDOClient, public Component {
     public:
         void dump_config() override;
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+
+namespace esphome {
+namespace ratgdo {
+
+    enum StateTimeIndex : uint8_t {
+        STATE_TIME_DOOR_OPEN,
+        STATE_TIME_LIGHT_ON,
+        STATE_TIME_MOTOR_ON,
+        STATE_TIME_OBSTRUCTED,
+        STATE_TIME_COUNT
+    };
+
+    // Seconds spent in one state: a running total plus the last 24 hours of
+    // uptime in hourly buckets, so no samples are kept. Only the total is
+    // saved across reboots.
+    struct StateTime {
+        uint32_t total;
+        uint16_t hours[24];
+        uint8_t hour;
+
+        void add(uint32_t seconds)
+        {
+            this->total += seconds;
+            this->hours[this->hour] += seconds;
+        }
+
+        void next_hour()
+        {
+            this->hour = (this->hour + 1) % 24;
+            this->hours[this->hour] = 0;
+        }
+
+        uint32_t last_day() const
+        {
+            uint32_t sum = 0;
+            for (auto seconds : this->hours) {
+                sum += seconds;
+            }
+            return sum;
+        }
+    };
+
+    // Books the time an on/off condition spends on into a StateTime.
+    class StateTimer {
+    public:
+        void set(bool active, uint32_t now)
+        {
+            if (active == this->active_) {
+                return;
+            }
+            this->update(now);
+            this->active_ = active;
+        }
+
+        // books the time since the last call, returns the seconds added
+        uint32_t update(uint32_t now)
+        {
+            if (this->active_) {
+                this->pending_ms_ += now - this->since_;
+            }
+            this->since_ = now;
+            uint32_t seconds = this->pending_ms_ / 1000;
+            this->pending_ms_ %= 1000;
+            this->time.add(seconds);
+            if (seconds > 0) {
+                this->changed_ = true;
+            }
+            return seconds;
+        }
+
+        // whether anything was booked since the last call, including by set()
+        bool take_changed()
+        {
+            bool changed = this->changed_;
+            this->changed_ = false;
+            return changed;
+        }
+
+        StateTime time {};
+
+    protected:
+        bool active_ { false };
+        uint32_t since_ { 0 };
+        uint32_t pending_ms_ { 0 };
+        bool changed_ { false };
+    };
+
+} // namespace ratgdo
+} // namespace esphome